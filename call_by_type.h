@@ -0,0 +1,136 @@
+/**
+ * Dispatch over a range of polymorphic guards grouped by the dynamic type of their pointees. The
+ * non null guards are partitioned into a bucket for each type of a given list, and the callable
+ * is invoked on each bucket in turn with the pointee's concrete type, so calls on a pointee of a
+ * final class, or qualified calls, are devirtualized and may be inlined. Calling one type at a
+ * time also avoids mispredicting the indirect branch of a virtual call when the types in the
+ * range are interleaved.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __CALL_BY_TYPE_H__
+#define __CALL_BY_TYPE_H__
+
+#include "ptr_guard.h"
+
+#include <array>
+#include <iterator>
+#include <typeinfo>
+#include <vector>
+
+namespace std {
+namespace experimental {
+    namespace __detail {
+        // The index of the first listed type which is exactly the dynamic type, or the number of
+        // listed types when none is.
+        template <class... Derived>
+        size_t type_bucket_index(type_info const& type) noexcept {
+            size_t index = 0;
+            ((type == typeid(Derived) ? true : (++index, false)) || ...);
+            return index;
+        }
+    }
+
+    // The buckets hold pointers to the pointees rather than the guards, and keep their capacity
+    // when cleared, so a type_buckets kept between dispatches over a range does not allocate.
+    // The guards must stay valid and unchanged until the buckets are cleared or assigned again.
+    template <class Base, class... Derived>
+    class type_buckets {
+        static_assert((is_base_of<Base, Derived>::value && ...), "Each type of a type_buckets must derive from its Base.");
+
+    public:
+        static constexpr size_t bucket_count = sizeof...(Derived) + 1;
+
+        type_buckets() = default;
+
+        template <class InputIt>
+        type_buckets(InputIt first, InputIt last) { insert(first, last); }
+
+        // Adds the pointees of the non null guards in [first, last). A pointee whose dynamic type
+        // is not one of the listed types, including Base itself, goes in a last bucket.
+        template <class InputIt>
+        void insert(InputIt first, InputIt last);
+
+        template <class InputIt>
+        void assign(InputIt first, InputIt last);
+
+        void clear() noexcept;
+
+        size_t size() const noexcept;
+        bool empty() const noexcept { return size() == 0; }
+
+        // Calls func with each pointee, cast to its listed type, one bucket after another in the
+        // order of the types. The pointees of the last bucket are passed as Base. Within a bucket
+        // pointees are visited in the order they were inserted. Returns the number of calls.
+        template <class Func>
+        size_t call(Func&& func) const;
+
+    private:
+        template <class D, class Func>
+        static void call_bucket(Func& func, vector<Base*> const& bucket);
+
+        array<vector<Base*>, bucket_count> _buckets;
+    };
+
+    // Partitions [first, last) and calls func with each pointee as its concrete type. Base is the
+    // element type of the guards, so for a range of ptr_guard<unique_ptr<Shape>>:
+    //
+    //     call_by_type<Circle, Square>(shapes.begin(), shapes.end(), [](auto& shape) { shape.draw(); });
+    template <class... Derived, class InputIt, class Func>
+    size_t call_by_type(InputIt first, InputIt last, Func&& func);
+
+    template <class Base, class... Derived>
+    template <class InputIt>
+    void type_buckets<Base, Derived...>::insert(InputIt first, InputIt last) {
+        for (; first != last; ++first) {
+            (*first).call([this](Base& pointee) {
+                _buckets[__detail::type_bucket_index<Derived...>(typeid(pointee))].push_back(std::addressof(pointee));
+            });
+        }
+    }
+
+    template <class Base, class... Derived>
+    template <class InputIt>
+    void type_buckets<Base, Derived...>::assign(InputIt first, InputIt last) {
+        clear();
+        insert(first, last);
+    }
+
+    template <class Base, class... Derived>
+    void type_buckets<Base, Derived...>::clear() noexcept {
+        for (vector<Base*>& bucket : _buckets) { bucket.clear(); }
+    }
+
+    template <class Base, class... Derived>
+    size_t type_buckets<Base, Derived...>::size() const noexcept {
+        size_t count = 0;
+        for (vector<Base*> const& bucket : _buckets) { count += bucket.size(); }
+        return count;
+    }
+
+    template <class Base, class... Derived>
+    template <class Func>
+    size_t type_buckets<Base, Derived...>::call(Func&& func) const {
+        size_t index = 0;
+        (call_bucket<Derived>(func, _buckets[index++]), ...);
+        call_bucket<Base>(func, _buckets.back());
+        return size();
+    }
+
+    template <class Base, class... Derived>
+    template <class D, class Func>
+    void type_buckets<Base, Derived...>::call_bucket(Func& func, vector<Base*> const& bucket) {
+        for (Base* pointee : bucket) { std::invoke(func, static_cast<D&>(*pointee)); }
+    }
+
+    template <class... Derived, class InputIt, class Func>
+    size_t call_by_type(InputIt first, InputIt last, Func&& func) {
+        typedef typename iterator_traits<InputIt>::value_type::element_type base_type;
+        return type_buckets<base_type, Derived...>(first, last).call(std::forward<Func>(func));
+    }
+}
+}
+
+#endif // __CALL_BY_TYPE_H__
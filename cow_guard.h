@@ -0,0 +1,101 @@
+/**
+ * A copy on write guard of a shared value. Copies of a cow_guard share the value, call() gives
+ * const access to it without copying, and call_mut() first clones the value if it is shared, so
+ * a mutation is never seen through the other copies.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __COW_GUARD_H__
+#define __COW_GUARD_H__
+
+#include "ptr_guard.h"
+
+namespace std {
+namespace experimental {
+    // The value is cloned when use_count() is above one. As for any copy on write type, distinct
+    // cow_guard objects may be used from different threads but one object may not, and a
+    // shared_ptr adopted by a cow_guard must not be kept or copied elsewhere.
+    template <class T>
+    class cow_guard {
+    public:
+        typedef T element_type;
+
+        constexpr cow_guard() noexcept = default;
+        cow_guard(nullptr_t) noexcept { }
+        explicit cow_guard(shared_ptr<T> value) noexcept : _guard(std::move(value)) { }
+        explicit cow_guard(ptr_guard<shared_ptr<T>> value) noexcept : _guard(std::move(value)) { }
+
+        operator bool() const noexcept { return static_cast<bool>(_guard); }
+        long use_count() const noexcept { return _guard.use_count(); }
+
+        void reset() noexcept { _guard.reset(); }
+        void swap(cow_guard& other) noexcept { _guard.swap(other._guard); }
+
+        // Calls func with a const reference to the value, and a dereference of each guard in args.
+        template <class Func, class... Args>
+        void call(Func&& func, Args&&... args) const;
+
+        template <class Func, class Ret, class... Args>
+        Ret call_or(Func&& func, Ret&& def, Args&&... args) const;
+
+        // Clones the value if it is shared, then calls func with a mutable reference to it.
+        template <class Func, class... Args>
+        void call_mut(Func&& func, Args&&... args);
+
+        template <class Func, class Ret, class... Args>
+        Ret call_mut_or(Func&& func, Ret&& def, Args&&... args);
+
+    private:
+        void make_unique();
+
+        ptr_guard<shared_ptr<T>> _guard;
+    };
+
+    template <class T, class... Args>
+    cow_guard<T> make_cow_guard(Args&&... args) {
+        return cow_guard<T>(std::make_shared<T>(std::forward<Args>(args)...));
+    }
+
+    template <class T>
+    template <class Func, class... Args>
+    void cow_guard<T>::call(Func&& func, Args&&... args) const {
+        _guard.call([&func](T const& value, auto&&... rest) {
+            std::invoke(func, value, std::forward<decltype(rest)>(rest)...);
+        }, std::forward<Args>(args)...);
+    }
+
+    template <class T>
+    template <class Func, class Ret, class... Args>
+    Ret cow_guard<T>::call_or(Func&& func, Ret&& def, Args&&... args) const {
+        return _guard.call_or([&func](T const& value, auto&&... rest) -> Ret {
+            return std::invoke(func, value, std::forward<decltype(rest)>(rest)...);
+        }, std::forward<Ret>(def), std::forward<Args>(args)...);
+    }
+
+    template <class T>
+    template <class Func, class... Args>
+    void cow_guard<T>::call_mut(Func&& func, Args&&... args) {
+        make_unique();
+        _guard.call(std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+
+    template <class T>
+    template <class Func, class Ret, class... Args>
+    Ret cow_guard<T>::call_mut_or(Func&& func, Ret&& def, Args&&... args) {
+        make_unique();
+        return _guard.call_or(std::forward<Func>(func), std::forward<Ret>(def), std::forward<Args>(args)...);
+    }
+
+    template <class T>
+    void cow_guard<T>::make_unique() {
+        if (_guard.use_count() <= 1) { return; }
+        shared_ptr<T> clone;
+        _guard.call([&clone](T const& value) { clone = std::make_shared<T>(value); });
+        _guard = std::move(clone);
+    }
+}
+}
+
+#endif // __COW_GUARD_H__
@@ -0,0 +1,212 @@
+/**
+ * A deleter which hands objects to a background thread for destruction. Guarding a
+ * unique_ptr<T, deferred_delete<T>> moves the cost of destroying large pointees on reset() or
+ * assignment off the calling thread. Objects are destroyed inline instead when the reclaimer's
+ * queue is full, so a slow reclaimer applies backpressure rather than growing without bound.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __DEFERRED_DELETE_H__
+#define __DEFERRED_DELETE_H__
+
+#include "ptr_guard.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace std {
+namespace experimental {
+    // Owns the thread destroying deferred objects and the bounded queue of objects waiting for
+    // it. Deferred objects are destroyed on the reclaimer thread so their destructors must be
+    // safe to run there.
+    class reclaimer {
+    public:
+        struct statistics {
+            size_t depth;
+            size_t max_depth;
+            uint64_t deferred;
+            uint64_t destroyed_inline;
+            uint64_t reclaimed;
+        };
+
+        static constexpr size_t default_capacity = 4096;
+
+        explicit reclaimer(size_t capacity = default_capacity);
+        ~reclaimer();
+
+        reclaimer(reclaimer const&) = delete;
+        reclaimer& operator =(reclaimer const&) = delete;
+
+        // The reclaimer used by default constructed deferred_delete objects, or nullptr once it
+        // has been destroyed at exit.
+        static reclaimer* global() noexcept;
+
+        // Queues the object for destruction, returning false when it should be destroyed inline.
+        bool defer(void* object, void (*destroy)(void*)) noexcept;
+
+        // Blocks until every object deferred before the call has been destroyed.
+        void drain();
+
+        statistics stats() const;
+        size_t capacity() const noexcept { return _queue.size(); }
+
+    private:
+        struct entry {
+            void* object;
+            void (*destroy)(void*);
+        };
+
+        void run();
+
+        mutable mutex _mutex;
+        condition_variable _ready;
+        condition_variable _drained;
+        vector<entry> _queue;
+        size_t _head = 0;
+        size_t _size = 0;
+        // Objects taken off the queue by the reclaimer thread but not yet destroyed. They still
+        // count against the capacity and the depth until they are destroyed.
+        size_t _inFlight = 0;
+        size_t _maxDepth = 0;
+        uint64_t _deferred = 0;
+        uint64_t _destroyedInline = 0;
+        uint64_t _reclaimed = 0;
+        bool _stopping = false;
+        thread _thread;
+    };
+
+    template <class T>
+    struct deferred_delete {
+        constexpr deferred_delete() noexcept = default;
+        explicit deferred_delete(reclaimer& r) noexcept : _reclaimer(&r) { }
+        template <class U, class = typename enable_if<is_convertible<U*, T*>::value>::type>
+        deferred_delete(deferred_delete<U> const& other) noexcept : _reclaimer(other._reclaimer) { }
+
+        void operator ()(T* p) const noexcept;
+
+    private:
+        template <class U>
+        friend struct deferred_delete;
+
+        reclaimer* _reclaimer = nullptr;
+    };
+
+    template <class T>
+    using deferred_unique_guard = ptr_guard<unique_ptr<T, deferred_delete<T>>>;
+
+    template <class T, class... Args>
+    deferred_unique_guard<T> make_guarded_deferred(Args&&... args) {
+        return deferred_unique_guard<T>(unique_ptr<T, deferred_delete<T>>(new T(std::forward<Args>(args)...)));
+    }
+
+    namespace __detail {
+        inline atomic<bool>& global_reclaimer_destroyed() noexcept {
+            static atomic<bool> destroyed(false);
+            return destroyed;
+        }
+    }
+
+    inline reclaimer::reclaimer(size_t capacity) : _queue(capacity ? capacity : 1) { }
+
+    inline reclaimer::~reclaimer() {
+        {
+            lock_guard<mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _ready.notify_one();
+        if (_thread.joinable()) { _thread.join(); }
+    }
+
+    inline reclaimer* reclaimer::global() noexcept {
+        struct holder {
+            ~holder() { __detail::global_reclaimer_destroyed().store(true, memory_order_release); }
+            reclaimer instance;
+        };
+
+        if (__detail::global_reclaimer_destroyed().load(memory_order_acquire)) { return nullptr; }
+        static holder global;
+        return &global.instance;
+    }
+
+    inline bool reclaimer::defer(void* object, void (*destroy)(void*)) noexcept {
+        {
+            lock_guard<mutex> lock(_mutex);
+            if (_stopping || _size + _inFlight == _queue.size()) {
+                ++_destroyedInline;
+                return false;
+            }
+            if (!_thread.joinable()) {
+                // The thread starts with the first deferred object so idle reclaimers cost nothing.
+                try {
+                    _thread = thread(&reclaimer::run, this);
+                } catch (...) {
+                    ++_destroyedInline;
+                    return false;
+                }
+            }
+            _queue[(_head + _size) % _queue.size()] = entry{ object, destroy };
+            ++_size;
+            ++_deferred;
+            if (_size + _inFlight > _maxDepth) { _maxDepth = _size + _inFlight; }
+        }
+        _ready.notify_one();
+        return true;
+    }
+
+    inline void reclaimer::drain() {
+        unique_lock<mutex> lock(_mutex);
+        _drained.wait(lock, [this] { return !_size && !_inFlight; });
+    }
+
+    inline reclaimer::statistics reclaimer::stats() const {
+        lock_guard<mutex> lock(_mutex);
+        return statistics{ _size + _inFlight, _maxDepth, _deferred, _destroyedInline, _reclaimed };
+    }
+
+    inline void reclaimer::run() {
+        vector<entry> batch;
+        batch.reserve(_queue.size());
+
+        unique_lock<mutex> lock(_mutex);
+        for (;;) {
+            _ready.wait(lock, [this] { return _size || _stopping; });
+            if (!_size) { return; }
+
+            // Take everything queued at once so producers only wait on the lock for a copy.
+            for (; _size; --_size) {
+                batch.push_back(_queue[_head]);
+                _head = (_head + 1) % _queue.size();
+            }
+            _inFlight = batch.size();
+            lock.unlock();
+
+            for (entry const& e : batch) {
+                e.destroy(e.object);
+            }
+
+            lock.lock();
+            _reclaimed += batch.size();
+            batch.clear();
+            _inFlight = 0;
+            if (!_size) { _drained.notify_all(); }
+        }
+    }
+
+    template <class T>
+    void deferred_delete<T>::operator ()(T* p) const noexcept {
+        static_assert(sizeof(T) > 0, "Cannot delete an incomplete type.");
+        reclaimer* r = _reclaimer ? _reclaimer : reclaimer::global();
+        if (!r || !r->defer(const_cast<void*>(static_cast<const volatile void*>(p)), [](void* object) { delete static_cast<T*>(object); })) {
+            delete p;
+        }
+    }
+}
+}
+
+#endif // __DEFERRED_DELETE_H__
@@ -0,0 +1,69 @@
+/**
+ * Guarded lookup in associative containers. find_guarded returns a ptr_guard to the mapped value
+ * in place of the iterator, so the lookup, the comparison with end() and the dereference cannot
+ * be separated. It works with any container having find() and end() whose iterators point at
+ * key, value pairs, including std::map, std::unordered_map and guard_flat_map.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __FIND_GUARDED_H__
+#define __FIND_GUARDED_H__
+
+#include "ptr_guard.h"
+
+namespace std {
+namespace experimental {
+    namespace __detail {
+        // The number of keys ahead of the current lookup whose probes a batch lookup starts.
+        constexpr size_t lookup_prefetch_distance = 8;
+
+        template <class Map, class Key>
+        auto prefetch_lookup(Map& map, Key const& key, int) -> decltype(map.prefetch(key), void()) {
+            map.prefetch(key);
+        }
+
+        template <class Map, class Key>
+        void prefetch_lookup(Map&, Key const&, long) { }
+    }
+
+    // The key is passed on to the container's find(), so heterogeneous lookup works wherever the
+    // container supports it, such as a std::map<std::string, V, std::less<>> searched with a
+    // std::string_view.
+    template <class Map, class Key>
+    auto find_guarded(Map& map, Key const& key) -> ptr_guard<decltype(std::addressof(map.find(key)->second))>;
+
+    // Looks up each of the keys in [first, last), writing a guard for each to out. For containers
+    // with a prefetch() member, such as guard_flat_map, the probes of later keys are started
+    // while the earlier keys are looked up.
+    template <class Map, class ForwardIt, class OutputIt>
+    OutputIt find_guarded(Map& map, ForwardIt first, ForwardIt last, OutputIt out);
+
+    template <class Map, class Key>
+    auto find_guarded(Map& map, Key const& key) -> ptr_guard<decltype(std::addressof(map.find(key)->second))> {
+        auto it = map.find(key);
+        if (it == map.end()) { return nullptr; }
+        return std::addressof(it->second);
+    }
+
+    template <class Map, class ForwardIt, class OutputIt>
+    OutputIt find_guarded(Map& map, ForwardIt first, ForwardIt last, OutputIt out) {
+        ForwardIt ahead = first;
+        for (size_t i = 0; i < __detail::lookup_prefetch_distance && ahead != last; ++i, ++ahead) {
+            __detail::prefetch_lookup(map, *ahead, 0);
+        }
+        for (; first != last; ++first) {
+            if (ahead != last) {
+                __detail::prefetch_lookup(map, *ahead, 0);
+                ++ahead;
+            }
+            *out = find_guarded(map, *first);
+            ++out;
+        }
+        return out;
+    }
+}
+}
+
+#endif // __FIND_GUARDED_H__
@@ -0,0 +1,268 @@
+/**
+ * A non owning pointer which detects when its pointee has been destroyed, even after the memory
+ * is reused for another object. Objects made by make_generation_ptr are allocated behind a
+ * generation count, which is advanced when the object is destroyed, and each generation_ptr
+ * keeps the generation it was made with. Testing the pointer compares the two, so a guard of a
+ * generation_ptr rejects a dangling pointer at the cost of a single extra compare.
+ *
+ * checked_guard<T> is a generation guard when PTR_GUARD_CHECKED_GENERATIONS is defined, and a
+ * plain ptr_guard<T*> otherwise, so canary builds may check for dangling guards while other
+ * builds pay nothing.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __GENERATION_PTR_H__
+#define __GENERATION_PTR_H__
+
+#include "ptr_guard.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace std {
+namespace experimental {
+    // Called with the address of the pointee when a dangling generation_ptr is tested. The
+    // default, a null handler, only rejects the pointer.
+    typedef void (*dangling_pointer_handler)(const void* pointee);
+
+    dangling_pointer_handler set_dangling_pointer_handler(dangling_pointer_handler handler) noexcept;
+
+    namespace __detail {
+        struct generation_header {
+            atomic<uint32_t> generation{ 0 };
+            void (*destroy)(generation_header*) noexcept;
+        };
+
+        inline atomic<dangling_pointer_handler>& dangling_handler() noexcept {
+            static atomic<dangling_pointer_handler> handler(nullptr);
+            return handler;
+        }
+
+        void report_dangling_pointer(const void* pointee) noexcept;
+
+        template <class T>
+        struct generation_block {
+            generation_header header;
+            alignas(T) unsigned char storage[sizeof(T)];
+        };
+
+        // Blocks are kept for reuse by objects of the same type and never given back to the
+        // allocator, so the generation of a destroyed object can always be read.
+        template <class T>
+        class generation_pool {
+        public:
+            static generation_pool& instance();
+
+            generation_block<T>* acquire();
+            void release(generation_block<T>* block) noexcept;
+
+        private:
+            mutex _lock;
+            vector<generation_block<T>*> _free;
+            size_t _allocated = 0;
+        };
+
+        template <class T>
+        void destroy_generation_object(generation_header* header) noexcept;
+    }
+
+    // The pointer is three words and trivially copyable. The pointee may only be destroyed through
+    // destroy_generation_ptr. Dangling pointers are detected, not races, so an object must not be
+    // destroyed while another thread is calling through a guard of it.
+    template <class T>
+    class generation_ptr {
+    public:
+        typedef T element_type;
+        typedef ptrdiff_t difference_type;
+
+        template <class U>
+        using rebind = generation_ptr<U>;
+
+    public:
+        constexpr generation_ptr() noexcept = default;
+        constexpr generation_ptr(nullptr_t) noexcept { }
+        template <class U, class = typename enable_if<is_convertible<U*, T*>::value>::type>
+        generation_ptr(generation_ptr<U> const& other) noexcept
+          : _ptr(other._ptr), _header(other._header), _generation(other._generation) { }
+
+        T* get() const noexcept { return _ptr; }
+        T& operator *() const noexcept { return *_ptr; }
+        T* operator ->() const noexcept { return _ptr; }
+
+        // False for a null pointer, and for a dangling pointer after reporting it.
+        explicit operator bool() const noexcept;
+
+        // True when the pointee has been destroyed, without reporting it.
+        bool dangling() const noexcept;
+
+        void reset() noexcept { *this = generation_ptr(); }
+        void swap(generation_ptr& other) noexcept { std::swap(*this, other); }
+
+    private:
+        template <class U>
+        friend class generation_ptr;
+
+        template <class U, class... Args>
+        friend generation_ptr<U> make_generation_ptr(Args&&... args);
+
+        template <class U>
+        friend void destroy_generation_ptr(generation_ptr<U>& p) noexcept;
+
+        generation_ptr(T* p, __detail::generation_header* header) noexcept
+          : _ptr(p), _header(header), _generation(header->generation.load(memory_order_relaxed)) { }
+
+        T* _ptr = nullptr;
+        __detail::generation_header* _header = nullptr;
+        uint32_t _generation = 0;
+    };
+
+    template <class T, class... Args>
+    generation_ptr<T> make_generation_ptr(Args&&... args);
+
+    // Destroys the pointee, leaving every other generation_ptr to it dangling, and resets p. Does
+    // nothing when p is null or already dangling.
+    template <class T>
+    void destroy_generation_ptr(generation_ptr<T>& p) noexcept;
+
+#ifdef PTR_GUARD_CHECKED_GENERATIONS
+    template <class T>
+    using checked_guard = ptr_guard<generation_ptr<T>>;
+#else
+    template <class T>
+    using checked_guard = ptr_guard<T*>;
+#endif
+
+    template <class T, class... Args>
+    checked_guard<T> make_checked_guard(Args&&... args);
+
+    template <class T>
+    void destroy_checked_guard(checked_guard<T>& guard) noexcept;
+
+    inline dangling_pointer_handler set_dangling_pointer_handler(dangling_pointer_handler handler) noexcept {
+        return __detail::dangling_handler().exchange(handler);
+    }
+
+    inline void __detail::report_dangling_pointer(const void* pointee) noexcept {
+        if (dangling_pointer_handler handler = dangling_handler().load(memory_order_relaxed)) { handler(pointee); }
+    }
+
+    template <class T>
+    __detail::generation_pool<T>& __detail::generation_pool<T>::instance() {
+        // Never destroyed, as objects may still be destroyed while static objects are.
+        static generation_pool* pool = new generation_pool();
+        return *pool;
+    }
+
+    template <class T>
+    __detail::generation_block<T>* __detail::generation_pool<T>::acquire() {
+        {
+            lock_guard<mutex> lock(_lock);
+            if (!_free.empty()) {
+                generation_block<T>* block = _free.back();
+                _free.pop_back();
+                return block;
+            }
+            // Reserving room to free every block keeps release from allocating.
+            _free.reserve(++_allocated);
+        }
+        return new generation_block<T>();
+    }
+
+    template <class T>
+    void __detail::generation_pool<T>::release(generation_block<T>* block) noexcept {
+        lock_guard<mutex> lock(_lock);
+        _free.push_back(block);
+    }
+
+    template <class T>
+    void __detail::destroy_generation_object(generation_header* header) noexcept {
+        generation_block<T>* block = reinterpret_cast<generation_block<T>*>(header);
+        reinterpret_cast<T*>(block->storage)->~T();
+        generation_pool<T>::instance().release(block);
+    }
+
+    template <class T>
+    generation_ptr<T>::operator bool() const noexcept {
+        if (!_ptr) { return false; }
+        if (_header->generation.load(memory_order_acquire) == _generation) { return true; }
+        __detail::report_dangling_pointer(_ptr);
+        return false;
+    }
+
+    template <class T>
+    bool generation_ptr<T>::dangling() const noexcept {
+        return _ptr && _header->generation.load(memory_order_acquire) != _generation;
+    }
+
+    template <class T, class... Args>
+    generation_ptr<T> make_generation_ptr(Args&&... args) {
+        __detail::generation_block<T>* block = __detail::generation_pool<T>::instance().acquire();
+        T* object;
+        try {
+            object = ::new (static_cast<void*>(block->storage)) T(std::forward<Args>(args)...);
+        } catch (...) {
+            __detail::generation_pool<T>::instance().release(block);
+            throw;
+        }
+        block->header.destroy = &__detail::destroy_generation_object<T>;
+        return generation_ptr<T>(object, &block->header);
+    }
+
+    template <class T>
+    void destroy_generation_ptr(generation_ptr<T>& p) noexcept {
+        if (!p._ptr || p.dangling()) { return; }
+        // The generation is advanced before the object is destroyed, so it is never seen live
+        // while being destroyed.
+        __detail::generation_header* header = p._header;
+        header->generation.fetch_add(1, memory_order_release);
+        header->destroy(header);
+        p.reset();
+    }
+
+    template <class T, class... Args>
+    checked_guard<T> make_checked_guard(Args&&... args) {
+#ifdef PTR_GUARD_CHECKED_GENERATIONS
+        return checked_guard<T>(make_generation_ptr<T>(std::forward<Args>(args)...));
+#else
+        return checked_guard<T>(new T(std::forward<Args>(args)...));
+#endif
+    }
+
+    template <class T>
+    void destroy_checked_guard(checked_guard<T>& guard) noexcept {
+#ifdef PTR_GUARD_CHECKED_GENERATIONS
+        destroy_generation_ptr(__detail::access_guarded_pointer(guard));
+#else
+        guard.call([](T& pointee) { delete std::addressof(pointee); });
+        guard.reset();
+#endif
+    }
+
+    template <class T1, class T2>
+    bool operator ==(generation_ptr<T1> const& a, generation_ptr<T2> const& b) noexcept { return a.get() == b.get(); }
+
+    template <class T1, class T2>
+    bool operator !=(generation_ptr<T1> const& a, generation_ptr<T2> const& b) noexcept { return a.get() != b.get(); }
+
+    template <class T>
+    bool operator ==(generation_ptr<T> const& a, nullptr_t) noexcept { return a.get() == nullptr; }
+
+    template <class T>
+    bool operator !=(generation_ptr<T> const& a, nullptr_t) noexcept { return a.get() != nullptr; }
+
+    template <class T1, class T2>
+    bool operator <(generation_ptr<T1> const& a, generation_ptr<T2> const& b) noexcept { return less<>()(a.get(), b.get()); }
+}
+
+    template <class T>
+    struct hash<experimental::generation_ptr<T>> {
+        size_t operator ()(experimental::generation_ptr<T> const& p) const noexcept { return hash<T*>()(p.get()); }
+    };
+}
+
+#endif // __GENERATION_PTR_H__
@@ -0,0 +1,626 @@
+/**
+ * An open addressing hash map intended to be keyed by ptr_guard objects. Keys are usually pointer
+ * identities so the hash is re-mixed before use and the table is probed a group of control bytes
+ * at a time (using SSE2 where it is available) in the manner of the Swiss tables.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __GUARD_FLAT_MAP_H__
+#define __GUARD_FLAT_MAP_H__
+
+#include "ptr_guard.h"
+
+#include <cstdint>
+#include <iterator>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define __GUARD_FLAT_MAP_SSE2__
+#endif
+
+namespace std {
+namespace experimental {
+    namespace __detail {
+        typedef int8_t ctrl_t;
+
+        // Control byte values, a full slot holds the low seven bits of the hash.
+        constexpr ctrl_t ctrl_empty = -128;
+        constexpr ctrl_t ctrl_deleted = -2;
+        constexpr ctrl_t ctrl_sentinel = -1;
+
+        inline size_t mix_pointer_hash(size_t h) noexcept {
+            // Pointer hashes are often the address itself, with the low bits always clear and
+            // the high bits rarely differing. Fold a multiplicative hash so all bits contribute.
+            uint64_t x = static_cast<uint64_t>(h) * 0x9E3779B97F4A7C15ull;
+            return static_cast<size_t>(x ^ (x >> 32));
+        }
+
+        // A group is the set of control bytes compared at once during a probe.
+        struct ctrl_group {
+            static constexpr size_t width = 16;
+
+            explicit ctrl_group(const ctrl_t* pos) noexcept {
+#ifdef __GUARD_FLAT_MAP_SSE2__
+                _ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+#else
+                memcpy(_ctrl, pos, width);
+#endif
+            }
+
+            uint32_t match(ctrl_t h2) const noexcept {
+#ifdef __GUARD_FLAT_MAP_SSE2__
+                return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), _ctrl)));
+#else
+                uint32_t mask = 0;
+                for (size_t i = 0; i < width; ++i) {
+                    mask |= static_cast<uint32_t>(_ctrl[i] == h2) << i;
+                }
+                return mask;
+#endif
+            }
+
+            uint32_t match_empty() const noexcept { return match(ctrl_empty); }
+
+            uint32_t match_empty_or_deleted() const noexcept {
+#ifdef __GUARD_FLAT_MAP_SSE2__
+                return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), _ctrl)));
+#else
+                uint32_t mask = 0;
+                for (size_t i = 0; i < width; ++i) {
+                    mask |= static_cast<uint32_t>(_ctrl[i] < -1) << i;
+                }
+                return mask;
+#endif
+            }
+
+#ifdef __GUARD_FLAT_MAP_SSE2__
+            __m128i _ctrl;
+#else
+            ctrl_t _ctrl[width];
+#endif
+        };
+
+        inline unsigned lowest_bit(uint32_t mask) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#else
+            unsigned i = 0;
+            while (!(mask & 1u)) { mask >>= 1; ++i; }
+            return i;
+#endif
+        }
+
+        inline void prefetch_read(const void* p) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(p);
+#elif defined(__GUARD_FLAT_MAP_SSE2__)
+            _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#else
+            (void)p;
+#endif
+        }
+
+        // Lookup by keys of other types is enabled, as for the standard unordered containers,
+        // when both the hash and the equality are transparent.
+        template <class Hash, class KeyEqual, class = void>
+        struct is_transparent_lookup : false_type { };
+
+        template <class Hash, class KeyEqual>
+        struct is_transparent_lookup<Hash, KeyEqual, decltype(void(declval<typename Hash::is_transparent*>()), void(declval<typename KeyEqual::is_transparent*>()))>
+          : true_type { };
+
+        // The number of clear bits above the highest set bit of a group mask.
+        inline unsigned leading_clear_bits(uint32_t mask) noexcept {
+            unsigned i = 0;
+            for (uint32_t bit = 1u << (ctrl_group::width - 1); bit && !(mask & bit); bit >>= 1) { ++i; }
+            return i;
+        }
+    }
+
+    template <class K, class V, class Hash = hash<K>, class KeyEqual = equal_to<K>>
+    class guard_flat_map {
+    public:
+        typedef K key_type;
+        typedef V mapped_type;
+        typedef pair<const K, V> value_type;
+        typedef size_t size_type;
+        typedef Hash hasher;
+        typedef KeyEqual key_equal;
+
+    private:
+        template <class Value>
+        class basic_iterator {
+        public:
+            typedef forward_iterator_tag iterator_category;
+            typedef typename guard_flat_map::value_type value_type;
+            typedef ptrdiff_t difference_type;
+            typedef Value* pointer;
+            typedef Value& reference;
+
+            basic_iterator() noexcept = default;
+            template <class Other, class = typename enable_if<is_convertible<Other*, Value*>::value>::type>
+            basic_iterator(basic_iterator<Other> const& other) noexcept
+              : _ctrl(other._ctrl), _slot(other._slot) { }
+
+            reference operator *() const noexcept { return *_slot; }
+            pointer operator ->() const noexcept { return _slot; }
+
+            basic_iterator& operator ++() noexcept {
+                ++_ctrl;
+                ++_slot;
+                skip_empty();
+                return *this;
+            }
+
+            basic_iterator operator ++(int) noexcept {
+                basic_iterator it = *this;
+                ++*this;
+                return it;
+            }
+
+            friend bool operator ==(basic_iterator const& a, basic_iterator const& b) noexcept { return a._slot == b._slot; }
+            friend bool operator !=(basic_iterator const& a, basic_iterator const& b) noexcept { return a._slot != b._slot; }
+
+        private:
+            friend class guard_flat_map;
+            template <class Other>
+            friend class basic_iterator;
+
+            basic_iterator(const __detail::ctrl_t* ctrl, Value* slot) noexcept : _ctrl(ctrl), _slot(slot) { }
+
+            // The control bytes are terminated by a sentinel so the scan needs no bound.
+            void skip_empty() noexcept {
+                while (*_ctrl < __detail::ctrl_sentinel) {
+                    ++_ctrl;
+                    ++_slot;
+                }
+            }
+
+            const __detail::ctrl_t* _ctrl = nullptr;
+            Value* _slot = nullptr;
+        };
+
+        template <class Key>
+        using enable_if_transparent = typename enable_if<__detail::is_transparent_lookup<Hash, KeyEqual>::value, Key>::type;
+
+    public:
+        typedef basic_iterator<value_type> iterator;
+        typedef basic_iterator<const value_type> const_iterator;
+
+        guard_flat_map() noexcept = default;
+        guard_flat_map(guard_flat_map const& other);
+        guard_flat_map(guard_flat_map&& other) noexcept;
+        ~guard_flat_map();
+
+        guard_flat_map& operator =(guard_flat_map other) noexcept;
+
+        iterator begin() noexcept;
+        const_iterator begin() const noexcept;
+        iterator end() noexcept;
+        const_iterator end() const noexcept;
+
+        bool empty() const noexcept { return _size == 0; }
+        size_type size() const noexcept { return _size; }
+        size_type capacity() const noexcept { return _capacity; }
+
+        void clear() noexcept;
+        void reserve(size_type count);
+        void swap(guard_flat_map& other) noexcept;
+
+        template <class... Args>
+        pair<iterator, bool> try_emplace(K const& key, Args&&... args);
+        template <class... Args>
+        pair<iterator, bool> try_emplace(K&& key, Args&&... args);
+
+        pair<iterator, bool> insert(value_type const& value);
+        pair<iterator, bool> insert(pair<K, V>&& value);
+
+        V& operator [](K const& key);
+        V& operator [](K&& key);
+
+        iterator find(K const& key) noexcept;
+        const_iterator find(K const& key) const noexcept;
+        size_type count(K const& key) const noexcept;
+        bool contains(K const& key) const noexcept;
+
+        template <class Key, class = enable_if_transparent<Key>>
+        iterator find(Key const& key) noexcept;
+        template <class Key, class = enable_if_transparent<Key>>
+        const_iterator find(Key const& key) const noexcept;
+        template <class Key, class = enable_if_transparent<Key>>
+        bool contains(Key const& key) const noexcept;
+
+        // Starts loading the memory a lookup of the key will probe first, so the lookups of a
+        // batch of keys can overlap their cache misses.
+        void prefetch(K const& key) const noexcept;
+        template <class Key, class = enable_if_transparent<Key>>
+        void prefetch(Key const& key) const noexcept;
+
+        size_type erase(K const& key) noexcept;
+        iterator erase(const_iterator pos) noexcept;
+
+    private:
+        template <class Key>
+        size_t hash_key(Key const& key) const noexcept;
+        template <class Key>
+        size_t find_index(Key const& key, size_t h) const noexcept;
+        size_t find_insert_index(size_t h) noexcept;
+        void set_ctrl(size_t index, __detail::ctrl_t value) noexcept;
+        void rehash(size_t capacity);
+        void destroy() noexcept;
+
+        template <class Key, class... Args>
+        pair<iterator, bool> emplace_key(Key&& key, Args&&... args);
+
+        // Capacities are one less than a power of two so the capacity is also the probe mask.
+        static constexpr size_t min_capacity = __detail::ctrl_group::width - 1;
+        static constexpr size_t npos = size_t(-1);
+
+        static size_t max_load(size_t capacity) noexcept { return capacity - capacity / 8; }
+
+        // _ctrl holds _capacity control bytes, a sentinel, then a copy of the first group width
+        // less one bytes so a group load starting anywhere in the table never wraps.
+        __detail::ctrl_t* _ctrl = nullptr;
+        value_type* _slots = nullptr;
+        size_t _capacity = 0;
+        size_t _size = 0;
+        size_t _growth_left = 0;
+        Hash _hash = {};
+        KeyEqual _equal = {};
+    };
+
+    template <class K, class V, class Hash, class KeyEqual>
+    guard_flat_map<K, V, Hash, KeyEqual>::guard_flat_map(guard_flat_map const& other)
+      : _hash(other._hash), _equal(other._equal) {
+        reserve(other._size);
+        for (value_type const& value : other) {
+            emplace_key(value.first, value.second);
+        }
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    guard_flat_map<K, V, Hash, KeyEqual>::guard_flat_map(guard_flat_map&& other) noexcept
+      : _hash(other._hash), _equal(other._equal) {
+        swap(other);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    guard_flat_map<K, V, Hash, KeyEqual>::~guard_flat_map() {
+        destroy();
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    guard_flat_map<K, V, Hash, KeyEqual>& guard_flat_map<K, V, Hash, KeyEqual>::operator =(guard_flat_map other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    typename guard_flat_map<K, V, Hash, KeyEqual>::iterator guard_flat_map<K, V, Hash, KeyEqual>::begin() noexcept {
+        if (!_capacity) { return end(); }
+        iterator it(_ctrl, _slots);
+        it.skip_empty();
+        return it;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    typename guard_flat_map<K, V, Hash, KeyEqual>::const_iterator guard_flat_map<K, V, Hash, KeyEqual>::begin() const noexcept {
+        return const_cast<guard_flat_map*>(this)->begin();
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    typename guard_flat_map<K, V, Hash, KeyEqual>::iterator guard_flat_map<K, V, Hash, KeyEqual>::end() noexcept {
+        return iterator(_ctrl + _capacity, _slots + _capacity);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    typename guard_flat_map<K, V, Hash, KeyEqual>::const_iterator guard_flat_map<K, V, Hash, KeyEqual>::end() const noexcept {
+        return const_cast<guard_flat_map*>(this)->end();
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    void guard_flat_map<K, V, Hash, KeyEqual>::clear() noexcept {
+        for (size_t i = 0; i < _capacity; ++i) {
+            if (_ctrl[i] >= 0) {
+                _slots[i].~value_type();
+            }
+        }
+        if (_capacity) {
+            memset(_ctrl, __detail::ctrl_empty, _capacity);
+            memset(_ctrl + _capacity + 1, __detail::ctrl_empty, __detail::ctrl_group::width - 1);
+        }
+        _size = 0;
+        _growth_left = max_load(_capacity);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    void guard_flat_map<K, V, Hash, KeyEqual>::reserve(size_type count) {
+        if (count <= _size + _growth_left) { return; }
+        size_t capacity = min_capacity;
+        while (max_load(capacity) < count) { capacity = capacity * 2 + 1; }
+        rehash(capacity);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    void guard_flat_map<K, V, Hash, KeyEqual>::swap(guard_flat_map& other) noexcept {
+        std::swap(_ctrl, other._ctrl);
+        std::swap(_slots, other._slots);
+        std::swap(_capacity, other._capacity);
+        std::swap(_size, other._size);
+        std::swap(_growth_left, other._growth_left);
+        std::swap(_hash, other._hash);
+        std::swap(_equal, other._equal);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    template <class... Args>
+    pair<typename guard_flat_map<K, V, Hash, KeyEqual>::iterator, bool>
+    guard_flat_map<K, V, Hash, KeyEqual>::try_emplace(K const& key, Args&&... args) {
+        return emplace_key(key, std::forward<Args>(args)...);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    template <class... Args>
+    pair<typename guard_flat_map<K, V, Hash, KeyEqual>::iterator, bool>
+    guard_flat_map<K, V, Hash, KeyEqual>::try_emplace(K&& key, Args&&... args) {
+        return emplace_key(std::move(key), std::forward<Args>(args)...);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    pair<typename guard_flat_map<K, V, Hash, KeyEqual>::iterator, bool>
+    guard_flat_map<K, V, Hash, KeyEqual>::insert(value_type const& value) {
+        return emplace_key(value.first, value.second);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    pair<typename guard_flat_map<K, V, Hash, KeyEqual>::iterator, bool>
+    guard_flat_map<K, V, Hash, KeyEqual>::insert(pair<K, V>&& value) {
+        return emplace_key(std::move(value.first), std::move(value.second));
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    V& guard_flat_map<K, V, Hash, KeyEqual>::operator [](K const& key) {
+        return emplace_key(key).first->second;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    V& guard_flat_map<K, V, Hash, KeyEqual>::operator [](K&& key) {
+        return emplace_key(std::move(key)).first->second;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    typename guard_flat_map<K, V, Hash, KeyEqual>::iterator guard_flat_map<K, V, Hash, KeyEqual>::find(K const& key) noexcept {
+        size_t index = find_index(key, hash_key(key));
+        if (index == npos) { return end(); }
+        return iterator(_ctrl + index, _slots + index);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    typename guard_flat_map<K, V, Hash, KeyEqual>::const_iterator guard_flat_map<K, V, Hash, KeyEqual>::find(K const& key) const noexcept {
+        return const_cast<guard_flat_map*>(this)->find(key);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    typename guard_flat_map<K, V, Hash, KeyEqual>::size_type guard_flat_map<K, V, Hash, KeyEqual>::count(K const& key) const noexcept {
+        return contains(key) ? 1 : 0;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    bool guard_flat_map<K, V, Hash, KeyEqual>::contains(K const& key) const noexcept {
+        return find_index(key, hash_key(key)) != npos;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    template <class Key, class>
+    typename guard_flat_map<K, V, Hash, KeyEqual>::iterator guard_flat_map<K, V, Hash, KeyEqual>::find(Key const& key) noexcept {
+        size_t index = find_index(key, hash_key(key));
+        if (index == npos) { return end(); }
+        return iterator(_ctrl + index, _slots + index);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    template <class Key, class>
+    typename guard_flat_map<K, V, Hash, KeyEqual>::const_iterator guard_flat_map<K, V, Hash, KeyEqual>::find(Key const& key) const noexcept {
+        return const_cast<guard_flat_map*>(this)->find(key);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    template <class Key, class>
+    bool guard_flat_map<K, V, Hash, KeyEqual>::contains(Key const& key) const noexcept {
+        return find_index(key, hash_key(key)) != npos;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    void guard_flat_map<K, V, Hash, KeyEqual>::prefetch(K const& key) const noexcept {
+        if (!_capacity) { return; }
+        size_t pos = (hash_key(key) >> 7) & _capacity;
+        __detail::prefetch_read(_ctrl + pos);
+        __detail::prefetch_read(_slots + pos);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    template <class Key, class>
+    void guard_flat_map<K, V, Hash, KeyEqual>::prefetch(Key const& key) const noexcept {
+        if (!_capacity) { return; }
+        size_t pos = (hash_key(key) >> 7) & _capacity;
+        __detail::prefetch_read(_ctrl + pos);
+        __detail::prefetch_read(_slots + pos);
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    typename guard_flat_map<K, V, Hash, KeyEqual>::size_type guard_flat_map<K, V, Hash, KeyEqual>::erase(K const& key) noexcept {
+        size_t index = find_index(key, hash_key(key));
+        if (index == npos) { return 0; }
+        erase(const_iterator(_ctrl + index, _slots + index));
+        return 1;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    typename guard_flat_map<K, V, Hash, KeyEqual>::iterator guard_flat_map<K, V, Hash, KeyEqual>::erase(const_iterator pos) noexcept {
+        size_t index = static_cast<size_t>(pos._slot - _slots);
+        _slots[index].~value_type();
+        --_size;
+
+        // A slot may return to empty only when no probe sequence could have passed over it,
+        // which holds when there is no run of a whole group of non empty slots through it.
+        size_t before = (index - __detail::ctrl_group::width) & _capacity;
+        uint32_t emptyAfter = __detail::ctrl_group(_ctrl + index).match_empty();
+        uint32_t emptyBefore = __detail::ctrl_group(_ctrl + before).match_empty();
+        bool wasNeverFull = emptyBefore && emptyAfter &&
+            __detail::lowest_bit(emptyAfter) + __detail::leading_clear_bits(emptyBefore) < __detail::ctrl_group::width;
+        if (wasNeverFull) {
+            set_ctrl(index, __detail::ctrl_empty);
+            ++_growth_left;
+        } else {
+            set_ctrl(index, __detail::ctrl_deleted);
+        }
+
+        iterator it(_ctrl + index, _slots + index);
+        it.skip_empty();
+        return it;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    template <class Key>
+    size_t guard_flat_map<K, V, Hash, KeyEqual>::hash_key(Key const& key) const noexcept {
+        return __detail::mix_pointer_hash(_hash(key));
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    template <class Key>
+    size_t guard_flat_map<K, V, Hash, KeyEqual>::find_index(Key const& key, size_t h) const noexcept {
+        if (!_capacity) { return npos; }
+        const size_t mask = _capacity;
+        const __detail::ctrl_t h2 = static_cast<__detail::ctrl_t>(h & 0x7F);
+        size_t pos = (h >> 7) & mask;
+        for (size_t step = __detail::ctrl_group::width; ; step += __detail::ctrl_group::width) {
+            __detail::ctrl_group group(_ctrl + pos);
+            for (uint32_t match = group.match(h2); match; match &= match - 1) {
+                size_t index = (pos + __detail::lowest_bit(match)) & mask;
+                if (_equal(_slots[index].first, key)) { return index; }
+            }
+            if (group.match_empty()) { return npos; }
+            pos = (pos + step) & mask;
+        }
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    size_t guard_flat_map<K, V, Hash, KeyEqual>::find_insert_index(size_t h) noexcept {
+        const size_t mask = _capacity;
+        size_t pos = (h >> 7) & mask;
+        for (size_t step = __detail::ctrl_group::width; ; step += __detail::ctrl_group::width) {
+            uint32_t match = __detail::ctrl_group(_ctrl + pos).match_empty_or_deleted();
+            if (match) { return (pos + __detail::lowest_bit(match)) & mask; }
+            pos = (pos + step) & mask;
+        }
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    void guard_flat_map<K, V, Hash, KeyEqual>::set_ctrl(size_t index, __detail::ctrl_t value) noexcept {
+        _ctrl[index] = value;
+        if (index < __detail::ctrl_group::width - 1) {
+            _ctrl[_capacity + 1 + index] = value;
+        }
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    template <class Key, class... Args>
+    pair<typename guard_flat_map<K, V, Hash, KeyEqual>::iterator, bool>
+    guard_flat_map<K, V, Hash, KeyEqual>::emplace_key(Key&& key, Args&&... args) {
+        size_t h = hash_key(key);
+        size_t index = find_index(key, h);
+        if (index != npos) {
+            return { iterator(_ctrl + index, _slots + index), false };
+        }
+
+        if (!_growth_left) {
+            // Rehash at the same capacity when tombstones, rather than live entries, have used
+            // up the table.
+            rehash(_capacity == 0 ? min_capacity : (_size <= max_load(_capacity) / 2 ? _capacity : _capacity * 2 + 1));
+        }
+
+        index = find_insert_index(h);
+        ::new (static_cast<void*>(_slots + index)) value_type(
+            piecewise_construct,
+            forward_as_tuple(std::forward<Key>(key)),
+            forward_as_tuple(std::forward<Args>(args)...));
+        if (_ctrl[index] == __detail::ctrl_empty) { --_growth_left; }
+        set_ctrl(index, static_cast<__detail::ctrl_t>(h & 0x7F));
+        ++_size;
+        return { iterator(_ctrl + index, _slots + index), true };
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    void guard_flat_map<K, V, Hash, KeyEqual>::rehash(size_t capacity) {
+        // Entries are relocated one at a time, so a move throwing part way would lose entries.
+        static_assert(is_nothrow_move_constructible<K>::value && is_nothrow_move_constructible<V>::value,
+                      "The keys and values of a guard_flat_map must be nothrow move constructible.");
+        const size_t width = __detail::ctrl_group::width;
+
+        // Both arrays are allocated before the map is changed, so it is left as it was when
+        // either allocation throws.
+        __detail::ctrl_t* newCtrl = static_cast<__detail::ctrl_t*>(::operator new(capacity + width));
+        value_type* newSlots;
+        try {
+            newSlots = allocator<value_type>().allocate(capacity);
+        } catch (...) {
+            ::operator delete(newCtrl);
+            throw;
+        }
+
+        __detail::ctrl_t* oldCtrl = _ctrl;
+        value_type* oldSlots = _slots;
+        size_t oldCapacity = _capacity;
+
+        _ctrl = newCtrl;
+        _slots = newSlots;
+        _capacity = capacity;
+        memset(_ctrl, __detail::ctrl_empty, capacity + width);
+        _ctrl[capacity] = __detail::ctrl_sentinel;
+        _growth_left = max_load(capacity) - _size;
+
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (oldCtrl[i] < 0) { continue; }
+            size_t h = hash_key(oldSlots[i].first);
+            size_t index = find_insert_index(h);
+            // Keys are const to users of the map but relocation owns the old slot outright.
+            ::new (static_cast<void*>(_slots + index)) value_type(
+                std::move(const_cast<K&>(oldSlots[i].first)),
+                std::move(oldSlots[i].second));
+            set_ctrl(index, static_cast<__detail::ctrl_t>(h & 0x7F));
+            oldSlots[i].~value_type();
+        }
+
+        if (oldCapacity) {
+            allocator<value_type>().deallocate(oldSlots, oldCapacity);
+            ::operator delete(oldCtrl);
+        }
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    void guard_flat_map<K, V, Hash, KeyEqual>::destroy() noexcept {
+        if (!_capacity) { return; }
+        clear();
+        allocator<value_type>().deallocate(_slots, _capacity);
+        ::operator delete(_ctrl);
+        _ctrl = nullptr;
+        _slots = nullptr;
+        _capacity = 0;
+        _growth_left = 0;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    void swap(guard_flat_map<K, V, Hash, KeyEqual>& a, guard_flat_map<K, V, Hash, KeyEqual>& b) noexcept {
+        a.swap(b);
+    }
+}
+}
+
+#ifdef __GUARD_FLAT_MAP_SSE2__
+#undef __GUARD_FLAT_MAP_SSE2__
+#endif // __GUARD_FLAT_MAP_SSE2__
+
+#endif // __GUARD_FLAT_MAP_H__
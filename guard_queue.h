@@ -0,0 +1,272 @@
+/**
+ * Bounded lock free queues handing guards of unique pointers between threads. Only the pointer
+ * is stored, so pushing a ptr_guard<unique_ptr<T>> releases its pointer into a slot and popping
+ * wraps it in a new guard, and a null guard is never enqueued. spsc_guard_queue connects one
+ * producer with one consumer, and mpsc_guard_queue any number of producers with one consumer.
+ * Both push and pop in batches, so a pipeline stage may hand over a burst of guards while
+ * touching the shared positions once.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __GUARD_QUEUE_H__
+#define __GUARD_QUEUE_H__
+
+#include "ptr_guard.h"
+
+#include <atomic>
+#include <memory>
+
+namespace std {
+namespace experimental {
+    namespace __detail {
+        // Capacities are rounded up to a power of two, so a position maps to its slot by a mask.
+        inline size_t guard_queue_capacity(size_t capacity) noexcept {
+            size_t rounded = 1;
+            while (rounded < capacity) { rounded *= 2; }
+            return rounded;
+        }
+
+        // Publishes the position reached by a batch even when handing a guard on throws.
+        struct guard_queue_publisher {
+            ~guard_queue_publisher() { shared.store(position, memory_order_release); }
+
+            atomic<size_t>& shared;
+            size_t& position;
+        };
+    }
+
+    // The pointers are deleted with the queue's deleter, not the deleters of the pushed guards,
+    // so Deleter should be stateless or the same for every guard. Pointers still queued when the
+    // queue is destroyed are deleted with it.
+    template <class T, class Deleter = default_delete<T>>
+    class spsc_guard_queue {
+    public:
+        typedef T element_type;
+        typedef Deleter deleter_type;
+        typedef ptr_guard<unique_ptr<T, Deleter>> guard_type;
+
+        explicit spsc_guard_queue(size_t capacity, Deleter deleter = Deleter());
+        ~spsc_guard_queue();
+
+        spsc_guard_queue(spsc_guard_queue const&) = delete;
+        spsc_guard_queue& operator =(spsc_guard_queue const&) = delete;
+
+        size_t capacity() const noexcept { return _mask + 1; }
+
+        // Called by the producer. Takes the pointer of the guard, leaving it null, and returns
+        // true, or returns false leaving the guard unchanged when the queue is full. A null guard
+        // is taken without being enqueued.
+        bool try_push(guard_type& guard) noexcept;
+
+        // Takes the guards of [first, last) in order until the queue is full, returning the
+        // number taken.
+        template <class InputIt>
+        size_t try_push(InputIt first, InputIt last) noexcept;
+
+        // Called by the consumer. Returns a null guard when the queue is empty.
+        guard_type try_pop();
+
+        // Writes up to max guards to out in the order they were pushed, returning the number
+        // written.
+        template <class OutputIt>
+        size_t try_pop(OutputIt out, size_t max);
+
+    private:
+        const size_t _mask;
+        unique_ptr<T*[]> _slots;
+        Deleter _deleter;
+
+        // The positions are written by one side each, and kept on cache lines of their own along
+        // with the last position seen of the other side, which is only read again when the
+        // queue seems full or empty.
+        alignas(64) atomic<size_t> _tail{ 0 };
+        size_t _cachedHead = 0;
+        alignas(64) atomic<size_t> _head{ 0 };
+        size_t _cachedTail = 0;
+    };
+
+    // A slot is claimed by producers with a compare and swap of the tail, then published by its
+    // own sequence, so a slow producer delays only the consumer, not other producers.
+    template <class T, class Deleter = default_delete<T>>
+    class mpsc_guard_queue {
+    public:
+        typedef T element_type;
+        typedef Deleter deleter_type;
+        typedef ptr_guard<unique_ptr<T, Deleter>> guard_type;
+
+        explicit mpsc_guard_queue(size_t capacity, Deleter deleter = Deleter());
+        ~mpsc_guard_queue();
+
+        mpsc_guard_queue(mpsc_guard_queue const&) = delete;
+        mpsc_guard_queue& operator =(mpsc_guard_queue const&) = delete;
+
+        size_t capacity() const noexcept { return _mask + 1; }
+
+        // May be called by any thread, as for spsc_guard_queue. The guards of a batch are each
+        // enqueued in order, but may be interleaved with those of other producers.
+        bool try_push(guard_type& guard) noexcept;
+
+        template <class InputIt>
+        size_t try_push(InputIt first, InputIt last) noexcept;
+
+        // Called by the consumer only.
+        guard_type try_pop();
+
+        template <class OutputIt>
+        size_t try_pop(OutputIt out, size_t max);
+
+    private:
+        struct cell {
+            atomic<size_t> sequence;
+            T* pointer;
+        };
+
+        const size_t _mask;
+        unique_ptr<cell[]> _cells;
+        Deleter _deleter;
+
+        alignas(64) atomic<size_t> _tail{ 0 };
+        alignas(64) size_t _head = 0;
+    };
+
+    template <class T, class Deleter>
+    spsc_guard_queue<T, Deleter>::spsc_guard_queue(size_t capacity, Deleter deleter)
+      : _mask(__detail::guard_queue_capacity(capacity) - 1),
+        _slots(new T*[_mask + 1]),
+        _deleter(std::move(deleter)) { }
+
+    template <class T, class Deleter>
+    spsc_guard_queue<T, Deleter>::~spsc_guard_queue() {
+        const size_t tail = _tail.load(memory_order_acquire);
+        for (size_t head = _head.load(memory_order_relaxed); head != tail; ++head) { _deleter(_slots[head & _mask]); }
+    }
+
+    template <class T, class Deleter>
+    bool spsc_guard_queue<T, Deleter>::try_push(guard_type& guard) noexcept {
+        return try_push(std::addressof(guard), std::addressof(guard) + 1) == 1;
+    }
+
+    template <class T, class Deleter>
+    template <class InputIt>
+    size_t spsc_guard_queue<T, Deleter>::try_push(InputIt first, InputIt last) noexcept {
+        size_t tail = _tail.load(memory_order_relaxed);
+        size_t taken = 0;
+        for (; first != last; ++first, ++taken) {
+            unique_ptr<T, Deleter>& p = __detail::access_guarded_pointer(*first);
+            if (!p) { continue; }
+            if (tail - _cachedHead > _mask) {
+                _cachedHead = _head.load(memory_order_acquire);
+                if (tail - _cachedHead > _mask) { break; }
+            }
+            _slots[tail & _mask] = p.release();
+            ++tail;
+        }
+        _tail.store(tail, memory_order_release);
+        return taken;
+    }
+
+    template <class T, class Deleter>
+    typename spsc_guard_queue<T, Deleter>::guard_type spsc_guard_queue<T, Deleter>::try_pop() {
+        guard_type popped;
+        try_pop(std::addressof(popped), 1);
+        return popped;
+    }
+
+    template <class T, class Deleter>
+    template <class OutputIt>
+    size_t spsc_guard_queue<T, Deleter>::try_pop(OutputIt out, size_t max) {
+        size_t head = _head.load(memory_order_relaxed);
+        size_t popped = 0;
+        __detail::guard_queue_publisher publisher{ _head, head };
+        for (; popped < max; ++popped) {
+            if (head == _cachedTail) {
+                _cachedTail = _tail.load(memory_order_acquire);
+                if (head == _cachedTail) { break; }
+            }
+            guard_type guard(unique_ptr<T, Deleter>(_slots[head & _mask], _deleter));
+            ++head;
+            *out = std::move(guard);
+            ++out;
+        }
+        return popped;
+    }
+
+    template <class T, class Deleter>
+    mpsc_guard_queue<T, Deleter>::mpsc_guard_queue(size_t capacity, Deleter deleter)
+      : _mask(__detail::guard_queue_capacity(capacity) - 1),
+        _cells(new cell[_mask + 1]),
+        _deleter(std::move(deleter)) {
+        for (size_t i = 0; i <= _mask; ++i) { _cells[i].sequence.store(i, memory_order_relaxed); }
+    }
+
+    template <class T, class Deleter>
+    mpsc_guard_queue<T, Deleter>::~mpsc_guard_queue() {
+        for (;;) {
+            cell& c = _cells[_head & _mask];
+            if (c.sequence.load(memory_order_acquire) != _head + 1) { break; }
+            _deleter(c.pointer);
+            ++_head;
+        }
+    }
+
+    template <class T, class Deleter>
+    bool mpsc_guard_queue<T, Deleter>::try_push(guard_type& guard) noexcept {
+        unique_ptr<T, Deleter>& p = __detail::access_guarded_pointer(guard);
+        if (!p) { return true; }
+
+        size_t tail = _tail.load(memory_order_relaxed);
+        for (;;) {
+            cell& c = _cells[tail & _mask];
+            const size_t sequence = c.sequence.load(memory_order_acquire);
+            if (sequence == tail) {
+                if (_tail.compare_exchange_weak(tail, tail + 1, memory_order_relaxed)) {
+                    c.pointer = p.release();
+                    c.sequence.store(tail + 1, memory_order_release);
+                    return true;
+                }
+            } else if (static_cast<ptrdiff_t>(sequence - tail) < 0) {
+                // The slot still holds the pointer pushed a lap earlier, so the queue is full.
+                return false;
+            } else {
+                tail = _tail.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    template <class T, class Deleter>
+    template <class InputIt>
+    size_t mpsc_guard_queue<T, Deleter>::try_push(InputIt first, InputIt last) noexcept {
+        size_t taken = 0;
+        for (; first != last && try_push(*first); ++first) { ++taken; }
+        return taken;
+    }
+
+    template <class T, class Deleter>
+    typename mpsc_guard_queue<T, Deleter>::guard_type mpsc_guard_queue<T, Deleter>::try_pop() {
+        guard_type popped;
+        try_pop(std::addressof(popped), 1);
+        return popped;
+    }
+
+    template <class T, class Deleter>
+    template <class OutputIt>
+    size_t mpsc_guard_queue<T, Deleter>::try_pop(OutputIt out, size_t max) {
+        size_t popped = 0;
+        for (; popped < max; ++popped) {
+            cell& c = _cells[_head & _mask];
+            if (c.sequence.load(memory_order_acquire) != _head + 1) { break; }
+            guard_type guard(unique_ptr<T, Deleter>(c.pointer, _deleter));
+            // Frees the slot for the push a lap later.
+            c.sequence.store(_head + _mask + 1, memory_order_release);
+            ++_head;
+            *out = std::move(guard);
+            ++out;
+        }
+        return popped;
+    }
+}
+}
+
+#endif // __GUARD_QUEUE_H__
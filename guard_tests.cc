@@ -2,6 +2,35 @@
 #include <catch.hpp>
 
 #include "ptr_guard.h"
+#include "call_by_type.h"
+#include "cow_guard.h"
+#include "deferred_delete.h"
+#include "find_guarded.h"
+#include "generation_ptr.h"
+#include "guard_flat_map.h"
+#include "guard_queue.h"
+#include "guarded_cache.h"
+#include "guarded_function.h"
+#include "mapped_graph.h"
+#include "observer_list.h"
+#include "offset_ptr.h"
+#include "pin_all.h"
+#include "sharded_shared_ptr.h"
+#include "synchronized_guard.h"
+#include "tagged_ptr.h"
+#include "tls_guard.h"
+#include "tracked_ptr.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #if __cplusplus > 201402L
 #ifndef __CPP17_SUPPORT__
@@ -977,28 +1006,1801 @@ TEST_CASE("Assignment of a ptr_guard<shared_ptr> from ptr_guard") {
     guard.call([](const Pointee& pointee) { REQUIRE(pointee.identifier == 2); });
 }
 
-/*TEST_CASE("Static cast of a ptr_guard<shared_ptr>") {
-    ptr_guard<DerivedFromPointee, shared_ptr<DerivedFromPointee>> guard(new DerivedFromPointee);
-    auto other = std::static_pointer_guard_cast<Pointee, DerivedFromPointee>(guard);
+TEST_CASE("Assignment of a ptr_guard<shared_ptr> from a temporary guard of a derived type") {
+    TestContext context;
+    ptr_guard<shared_ptr<Pointee>> guard(new Pointee(1));
+
+    guard = ptr_guard<shared_ptr<DerivedFromPointee>>(make_shared<DerivedFromPointee>());
+
+    REQUIRE(1 == context.pointeeDestructorCalls);
+    REQUIRE(1 == guard.use_count());
+    guard.call([](const Pointee& pointee) { REQUIRE(pointee.identifier == 0); });
+}
+
+TEST_CASE("Static cast of a ptr_guard<shared_ptr>") {
+    ptr_guard<shared_ptr<DerivedFromPointee>> guard(new DerivedFromPointee);
+    ptr_guard<shared_ptr<Pointee>> other = static_pointer_cast<Pointee>(guard);
     REQUIRE(guard);
+    REQUIRE(other);
+    REQUIRE(2 == guard.use_count());
+
+    ptr_guard<shared_ptr<DerivedFromPointee>> back = static_pointer_cast<DerivedFromPointee>(std::move(other));
+    REQUIRE(back);
+    REQUIRE(!other);
+    REQUIRE(2 == guard.use_count());
 }
 
 TEST_CASE("Dynamic cast of a ptr_guard<shared_ptr>") {
-    ptr_guard<Pointee, shared_ptr<Pointee>> guard(new DerivedFromPointee);
-    auto other = std::dynamic_pointer_cast<DerivedFromPointee, Pointee>(guard);
+    ptr_guard<shared_ptr<Pointee>> guard(new DerivedFromPointee);
+    ptr_guard<shared_ptr<DerivedFromPointee>> other = dynamic_pointer_cast<DerivedFromPointee>(guard);
     REQUIRE(guard);
+    REQUIRE(other);
+    REQUIRE(guard == other);
+
+    ptr_guard<shared_ptr<Pointee>> base(new Pointee);
+    REQUIRE(!dynamic_pointer_cast<DerivedFromPointee>(base));
+    REQUIRE(!dynamic_pointer_cast<DerivedFromPointee>(std::move(base)));
+    REQUIRE(base);
+}
+
+TEST_CASE("Repeated dynamic casts give the same results as dynamic_cast") {
+    struct Other { virtual ~Other() = default; };
+    struct Both : public Other, public DerivedFromPointee { };
+
+    Pointee pointee;
+    DerivedFromPointee derived;
+    Both both;
+    for (int i = 0; i < 3; ++i) {
+        ptr_guard<Pointee*> guards[] = { &pointee, &derived, &both, nullptr };
+        for (ptr_guard<Pointee*> const& guard : guards) {
+            Pointee* raw = guard.call_or([](Pointee& p) { return &p; }, static_cast<Pointee*>(nullptr));
+            REQUIRE(dynamic_pointer_cast<DerivedFromPointee>(guard) == ptr_guard<DerivedFromPointee*>(dynamic_cast<DerivedFromPointee*>(raw)));
+            REQUIRE(dynamic_pointer_cast<Other>(guard) == ptr_guard<Other*>(dynamic_cast<Other*>(raw)));
+        }
+    }
 }
 
 TEST_CASE("Const cast of a ptr_guard<shared_ptr>") {
-    const ptr_guard<Pointee, shared_ptr<Pointee>> guard(new Pointee);
-    auto other = std::const_pointer_cast<Pointee, Pointee>(guard);
+    const ptr_guard<shared_ptr<const Pointee>> guard(new Pointee);
+    ptr_guard<shared_ptr<Pointee>> other = const_pointer_cast<Pointee>(guard);
     REQUIRE(guard);
-}*/
+    other.call([](Pointee& pointee) { pointee.identifier = 1; });
+    guard.call([](const Pointee& pointee) { REQUIRE(1 == pointee.identifier); });
+}
 
-#ifdef __CPP17_SUPPORT__
 TEST_CASE("Reinterpret cast of a ptr_guard<shared_ptr>") {
-    ptr_guard<Pointee, shared_ptr<Pointee>> guard(new Pointee);
-    auto other = std::reinterpret_pointer_cast<DerivedFromPointee>(guard);
+    ptr_guard<shared_ptr<Pointee>> guard(new Pointee);
+    auto other = reinterpret_pointer_cast<DerivedFromPointee>(guard);
+    REQUIRE(guard);
+    REQUIRE(other);
+}
+
+TEST_CASE("Casts of a ptr_guard<unique_ptr> transfer ownership") {
+    TestContext context;
+    ptr_guard<unique_ptr<Pointee>> guard(new DerivedFromPointee);
+
+    ptr_guard<unique_ptr<DerivedFromPointee>> derived = dynamic_pointer_cast<DerivedFromPointee>(std::move(guard));
+    REQUIRE(derived);
+    REQUIRE(!guard);
+
+    guard = static_pointer_cast<Pointee>(std::move(derived));
+    REQUIRE(guard);
+    REQUIRE(!derived);
+
+    guard.reset(new Pointee);
+    REQUIRE(1 == context.pointeeDestructorCalls);
+    REQUIRE(!dynamic_pointer_cast<DerivedFromPointee>(std::move(guard)));
     REQUIRE(guard);
+    REQUIRE(1 == context.pointeeDestructorCalls);
+}
+
+TEST_CASE("Casts of a ptr_guard<T*> and ptr_guard<weak_ptr>") {
+    DerivedFromPointee pointee;
+    ptr_guard<Pointee*> guard(&pointee);
+    ptr_guard<DerivedFromPointee*> derived = static_pointer_cast<DerivedFromPointee>(guard);
+    REQUIRE(derived == guard);
+
+    shared_ptr<Pointee> owner(new DerivedFromPointee);
+    ptr_guard<weak_ptr<Pointee>> weak(owner);
+    ptr_guard<weak_ptr<DerivedFromPointee>> weakDerived = dynamic_pointer_cast<DerivedFromPointee>(weak);
+    REQUIRE(weakDerived == weak);
+    owner.reset();
+    REQUIRE(!dynamic_pointer_cast<DerivedFromPointee>(weak));
+}
+
+TEST_CASE("Comparing ptr_guards") {
+    Pointee pointee1, pointee2;
+    ptr_guard<Pointee*> guard1(&pointee1);
+    ptr_guard<Pointee*> guard2(&pointee2);
+    ptr_guard<Pointee*> nullGuard;
+
+    REQUIRE(guard1 == ptr_guard<Pointee*>(&pointee1));
+    REQUIRE(guard1 != guard2);
+    REQUIRE(nullGuard == nullptr);
+    REQUIRE(nullptr == nullGuard);
+    REQUIRE(guard1 != nullptr);
+    REQUIRE((guard1 < guard2) == std::less<Pointee*>()(&pointee1, &pointee2));
+    REQUIRE((guard1 < guard2) != (guard1 > guard2));
+    REQUIRE(guard1 <= guard1);
+    REQUIRE(guard1 >= guard1);
+
+    shared_ptr<Pointee> owner(new Pointee);
+    ptr_guard<shared_ptr<Pointee>> shared1(owner);
+    ptr_guard<shared_ptr<Pointee>> shared2(owner);
+    REQUIRE(shared1 == shared2);
+    REQUIRE(shared1 != ptr_guard<shared_ptr<Pointee>>(new Pointee));
+}
+
+TEST_CASE("Comparing ptr_guard<weak_ptr> uses the owner") {
+    shared_ptr<Pointee> owner(new Pointee);
+    shared_ptr<Pointee> otherOwner(new Pointee);
+    ptr_guard<weak_ptr<Pointee>> weak1(owner);
+    ptr_guard<weak_ptr<Pointee>> weak2(owner);
+    ptr_guard<weak_ptr<Pointee>> other(otherOwner);
+
+    REQUIRE(weak1 == weak2);
+    REQUIRE(weak1 != other);
+    REQUIRE(weak1 == ptr_guard<shared_ptr<Pointee>>(owner));
+    REQUIRE((weak1 < other) == owner.owner_before(otherOwner));
+
+    owner.reset();
+    REQUIRE(weak1 == nullptr);
+    REQUIRE(weak1 == weak2);
+}
+
+TEST_CASE("Hashing ptr_guards") {
+    Pointee pointee;
+    REQUIRE(hash<ptr_guard<Pointee*>>()(&pointee) == hash<ptr_guard<Pointee*>>()(&pointee));
+
+    shared_ptr<Pointee> owner(new Pointee);
+    ptr_guard<shared_ptr<Pointee>> shared(owner);
+    REQUIRE(hash<ptr_guard<shared_ptr<Pointee>>>()(shared) == hash<shared_ptr<Pointee>>()(owner));
+
+    ptr_guard<weak_ptr<Pointee>> weak1(owner);
+    ptr_guard<weak_ptr<Pointee>> weak2(owner);
+    size_t weakHash = hash<ptr_guard<weak_ptr<Pointee>>>()(weak1);
+    REQUIRE(weakHash == hash<ptr_guard<weak_ptr<Pointee>>>()(weak2));
+    owner.reset();
+    REQUIRE(weakHash == hash<ptr_guard<weak_ptr<Pointee>>>()(weak1));
+
+    unordered_set<ptr_guard<weak_ptr<Pointee>>> weakSet;
+    weakSet.insert(weak1);
+    weakSet.insert(weak2);
+    REQUIRE(1 == weakSet.size());
+}
+
+TEST_CASE("A guard_flat_map keyed by ptr_guards") {
+    typedef ptr_guard<shared_ptr<Pointee>> Key;
+    guard_flat_map<Key, int> map;
+    REQUIRE(map.empty());
+    REQUIRE(map.find(Key()) == map.end());
+
+    vector<Key> keys;
+    for (int i = 0; i < 1000; ++i) {
+        keys.push_back(Key(new Pointee(i)));
+        REQUIRE(map.try_emplace(keys.back(), i).second);
+    }
+    REQUIRE(1000 == map.size());
+    REQUIRE_FALSE(map.try_emplace(keys[10], -1).second);
+
+    for (int i = 0; i < 1000; ++i) {
+        auto it = map.find(keys[i]);
+        REQUIRE(it != map.end());
+        REQUIRE(i == it->second);
+    }
+    REQUIRE_FALSE(map.contains(Key(new Pointee)));
+
+    SECTION("Iteration visits every entry once") {
+        int sum = 0;
+        size_t visited = 0;
+        for (auto const& entry : map) {
+            sum += entry.second;
+            ++visited;
+        }
+        REQUIRE(1000 == visited);
+        REQUIRE(999 * 1000 / 2 == sum);
+    }
+    SECTION("Erasing and reinserting entries") {
+        for (int i = 0; i < 1000; i += 2) {
+            REQUIRE(1 == map.erase(keys[i]));
+        }
+        REQUIRE(500 == map.size());
+        REQUIRE(0 == map.erase(keys[0]));
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE((i % 2 == 1) == map.contains(keys[i]));
+        }
+        for (int i = 0; i < 1000; i += 2) {
+            map[keys[i]] = -i;
+        }
+        REQUIRE(1000 == map.size());
+        REQUIRE(-4 == map[keys[4]]);
+    }
+    SECTION("Copying and clearing the map") {
+        guard_flat_map<Key, int> copy(map);
+        map.clear();
+        REQUIRE(map.empty());
+        REQUIRE(1000 == copy.size());
+        REQUIRE(2 == keys[7].use_count());
+        REQUIRE(7 == copy[keys[7]]);
+    }
+}
+
+TEST_CASE("A guard_flat_map keyed by ptr_guard<unique_ptr>") {
+    guard_flat_map<ptr_guard<unique_ptr<Pointee>>, int> map;
+    for (int i = 0; i < 100; ++i) {
+        map.try_emplace(ptr_guard<unique_ptr<Pointee>>(new Pointee(i)), i);
+    }
+    REQUIRE(100 == map.size());
+    for (auto const& entry : map) {
+        entry.first.call([&](const Pointee& pointee) { REQUIRE(pointee.identifier == entry.second); });
+    }
+}
+
+TEST_CASE("Using a ptr_guard<offset_ptr>") {
+    static_assert(std::is_same<typename ptr_guard<offset_ptr<Pointee>>::pointer, offset_ptr<Pointee>>::value, "Pointer type offset_ptr<T> is an offset_ptr<T>");
+    static_assert(std::is_same<typename ptr_guard<offset_ptr<Pointee>>::element_type, Pointee>::value, "Element type of offset_ptr<T> is T");
+
+    SECTION("A default constructed ptr_guard") {
+        ptr_guard<offset_ptr<Pointee>> guard;
+
+        REQUIRE(!guard);
+        REQUIRE(!pointee_is_accessible(guard));
+    }
+    SECTION("A ptr_guard constructed with a non null pointer") {
+        Pointee pointee;
+        ptr_guard<offset_ptr<Pointee>> guard(&pointee);
+
+        REQUIRE(guard);
+        REQUIRE(pointee_is_accessible(guard));
+
+        SECTION("A copy points at the same pointee.") {
+            ptr_guard<offset_ptr<Pointee>> copy(guard);
+            REQUIRE(copy == guard);
+            copy.call([&](Pointee& p) { REQUIRE(&p == &pointee); });
+        }
+        SECTION("After reset of the pointer guard.") {
+            guard.reset();
+
+            REQUIRE(!guard);
+            REQUIRE(!pointee_is_accessible(guard));
+        }
+    }
+}
+
+namespace {
+    struct GraphNode {
+        int value = 0;
+        ptr_guard<offset_ptr<GraphNode>> left;
+        ptr_guard<offset_ptr<GraphNode>> right;
+    };
+
+    int sum_graph(const GraphNode& node) {
+        return node.value +
+            node.left.call_or([](const GraphNode& left) { return sum_graph(left); }, 0) +
+            node.right.call_or([](const GraphNode& right) { return sum_graph(right); }, 0);
+    }
+}
+
+namespace std {
+namespace experimental {
+    template <>
+    struct is_mappable<GraphNode> : true_type { };
+}
+}
+
+TEST_CASE("Writing and mapping an object graph of ptr_guard<offset_ptr>") {
+    const char* path = "guard_tests_graph.bin";
+    {
+        mapped_graph_writer writer(1024);
+        GraphNode* root = writer.construct<GraphNode>();
+        GraphNode* left = writer.construct<GraphNode>();
+        GraphNode* right = writer.construct<GraphNode>();
+        root->value = 1;
+        left->value = 2;
+        right->value = 3;
+        root->left = left;
+        root->right = right;
+        left->right = right;
+        writer.set_root(root);
+        writer.write(path);
+    }
+    {
+        mapped_graph graph(path);
+        ptr_guard<const GraphNode*> root = graph.root<GraphNode>();
+        REQUIRE(root);
+        REQUIRE(9 == root.call_or([](const GraphNode& node) { return sum_graph(node); }, 0));
+
+        mapped_graph moved(std::move(graph));
+        REQUIRE(!graph.root<GraphNode>());
+        REQUIRE(moved.root<GraphNode>() == root);
+    }
+    REQUIRE_THROWS_AS(mapped_graph("guard_tests_missing.bin"), std::system_error);
+    std::remove(path);
+}
+
+TEST_CASE("Padding in a mapped graph is written as zeros") {
+    static_assert(is_mappable<uint64_t>::value, "Trivially copyable types are mappable");
+    static_assert(!is_mappable<ptr_guard<offset_ptr<Pointee>>>::value, "Types holding offset_ptrs are declared mappable");
+
+    const char* path = "guard_tests_padding.bin";
+    {
+        mapped_graph_writer writer(64);
+        *writer.construct<char>() = 'x';
+        writer.set_root(writer.construct<uint64_t>(42));
+        writer.write(path);
+    }
+    {
+        mapped_graph graph(path);
+        REQUIRE(42 == graph.root<uint64_t>().call_or([](uint64_t value) { return value; }, uint64_t(0)));
+    }
+
+    // The header is three words, then the char and the padding up to the uint64_t.
+    unsigned char bytes[40] = {};
+    FILE* file = std::fopen(path, "rb");
+    REQUIRE(sizeof(bytes) == std::fread(bytes, 1, sizeof(bytes), file));
+    std::fclose(file);
+    REQUIRE('x' == bytes[24]);
+    for (int i = 25; i < 32; ++i) { REQUIRE(0 == bytes[i]); }
+    std::remove(path);
+}
+
+TEST_CASE("A mapped graph whose root does not fit gives a null guard") {
+    const char* path = "guard_tests_corrupt.bin";
+    auto write_graph = [&](uint64_t root) {
+        uint64_t words[4] = { std::experimental::__detail::mapped_graph_magic, sizeof(words), root, 42 };
+        FILE* file = std::fopen(path, "wb");
+        std::fwrite(words, sizeof(words), 1, file);
+        std::fclose(file);
+    };
+
+    write_graph(24);
+    REQUIRE(42 == mapped_graph(path).root<uint64_t>().call_or([](uint64_t value) { return value; }, uint64_t(0)));
+    REQUIRE(!mapped_graph(path).root<GraphNode>());
+
+    write_graph(25);
+    REQUIRE(!mapped_graph(path).root<uint32_t>());
+    REQUIRE(mapped_graph(path).root<char>());
+    std::remove(path);
+}
+
+#ifdef __CPP17_SUPPORT__
+TEST_CASE("Using an inline_guard") {
+    static_assert(std::is_same<typename inline_guard<Pointee>::pointer, optional<Pointee>>::value, "Pointer type of an inline_guard<T> is an optional<T>");
+    static_assert(std::is_same<typename inline_guard<Pointee>::element_type, Pointee>::value, "Element type of an inline_guard<T> is T");
+    static_assert(sizeof(inline_guard<Pointee>) == sizeof(optional<Pointee>), "An inline_guard holds its element in place");
+
+    SECTION("A default constructed inline_guard") {
+        inline_guard<Pointee> guard;
+
+        REQUIRE(!guard);
+        REQUIRE(!pointee_is_accessible(guard));
+        REQUIRE(ptr_guards_and_contents_are_passed_by_reference(guard));
+    }
+    SECTION("An inline_guard holding an element") {
+        inline_guard<Pointee> guard = make_guarded_inline<Pointee>(1);
+
+        REQUIRE(guard);
+        REQUIRE(pointee_is_accessible(guard));
+        REQUIRE(ptr_guards_and_contents_are_passed_by_reference(guard));
+        REQUIRE(1 == guard.call_or([](const Pointee& pointee) { return pointee.identifier; }, 0));
+
+        SECTION("After reset of the guard with constructor arguments.") {
+            TestContext context;
+            guard.reset(2);
+
+            REQUIRE(1 == context.pointeeDestructorCalls);
+            REQUIRE(2 == guard.call_or([](const Pointee& pointee) { return pointee.identifier; }, 0));
+        }
+        SECTION("After reset of the guard.") {
+            TestContext context;
+            guard.reset();
+
+            REQUIRE(!guard);
+            REQUIRE(1 == context.pointeeDestructorCalls);
+            REQUIRE(!pointee_is_accessible(guard));
+        }
+    }
+}
+#endif
+
+#ifdef __CPP17_SUPPORT__
+namespace {
+    struct Unmovable {
+        Unmovable(int v) : value(v) { }
+        Unmovable(const Unmovable&) = delete;
+        Unmovable(Unmovable&&) = delete;
+
+        int value;
+    };
+}
+
+TEST_CASE("Getting an optional result from a ptr_guard") {
+    Pointee pointee(1), other(2);
+    ptr_guard<Pointee*> guard(&pointee);
+    ptr_guard<Pointee*> otherGuard(&other);
+    ptr_guard<Pointee*> nullGuard;
+
+    SECTION("A result by value") {
+        optional<int> result = guard.call_optional([](const Pointee& p) { return p.identifier; });
+        REQUIRE(result);
+        REQUIRE(1 == *result);
+
+        REQUIRE(!nullGuard.call_optional([](const Pointee& p) { return p.identifier; }));
+    }
+    SECTION("Other guards and arguments are passed on") {
+        optional<int> result = guard.call_optional(
+            [](const Pointee& a, const Pointee& b, int c) { return a.identifier + b.identifier + c; }, otherGuard, 3);
+        REQUIRE(6 == *result);
+
+        REQUIRE(!guard.call_optional(
+            [](const Pointee& a, const Pointee& b) { return a.identifier + b.identifier; }, nullGuard));
+    }
+    SECTION("A result which cannot be moved is constructed in place") {
+        optional<Unmovable> result = guard.call_optional([](const Pointee& p) { return Unmovable(p.identifier); });
+        REQUIRE(result);
+        REQUIRE(1 == result->value);
+    }
+    SECTION("A reference result is returned as a guard") {
+        ptr_guard<int*> result = guard.call_optional([](Pointee& p) -> int& { return p.identifier; });
+        REQUIRE(result);
+        result.call([](int& identifier) { identifier = 3; });
+        REQUIRE(3 == pointee.identifier);
+
+        ptr_guard<const int*> nullResult = nullGuard.call_optional([](const Pointee& p) -> const int& { return p.identifier; });
+        REQUIRE(!nullResult);
+    }
+}
+#endif
+
+#ifdef __CPP17_SUPPORT__
+namespace {
+    int countingPtrTests = 0;
+
+    template <typename T>
+    struct CountingPtr {
+        CountingPtr() {}
+        CountingPtr(T* p) : ptr(p) {}
+
+        explicit operator bool() const noexcept { ++countingPtrTests; return static_cast<bool>(ptr); }
+        T& operator *() { return *ptr; }
+
+        T* ptr = nullptr;
+    };
+}
+
+namespace std {
+    template <class T>
+    class pointer_traits<CountingPtr<T>> {
+    public:
+        typedef CountingPtr<T> pointer;
+        typedef T element_type;
+    };
+}
+
+TEST_CASE("Matching on the combination of valid guards") {
+    Pointee pointee1(1), pointee2(2);
+    ptr_guard<Pointee*> guard1(&pointee1);
+    ptr_guard<Pointee*> guard2(&pointee2);
+    ptr_guard<Pointee*> nullGuard;
+
+    auto match = [](ptr_guard<Pointee*> a, ptr_guard<Pointee*> b) {
+        int result = 0;
+        call_match(a, b,
+            [&](Pointee& x, Pointee& y) { result = x.identifier * 10 + y.identifier; },
+            [&](Pointee& x, nullopt_t) { result = x.identifier; },
+            [&](nullopt_t, Pointee& y) { result = -y.identifier; },
+            [&]() { result = 100; });
+        return result;
+    };
+
+    REQUIRE(12 == match(guard1, guard2));
+    REQUIRE(1 == match(guard1, nullGuard));
+    REQUIRE(-2 == match(nullGuard, guard2));
+    REQUIRE(100 == match(nullGuard, nullGuard));
+
+    SECTION("Null guards may be left out of the handler arguments") {
+        int result = 0;
+        call_match(nullGuard, guard2,
+            [&](Pointee& x, Pointee& y) { result = 3; },
+            [&](Pointee& y) { result = y.identifier; });
+        REQUIRE(2 == result);
+    }
+    SECTION("Combinations without a handler are not handled") {
+        bool called = false;
+        call_match(guard1, nullGuard, [&](Pointee& x, Pointee& y) { called = true; });
+        REQUIRE_FALSE(called);
+    }
+    SECTION("Each guard is tested once") {
+        Pointee pointee3(3);
+        ptr_guard<CountingPtr<Pointee>> counted1(&pointee1);
+        ptr_guard<CountingPtr<Pointee>> counted2;
+        ptr_guard<CountingPtr<Pointee>> counted3(&pointee3);
+        countingPtrTests = 0;
+
+        int result = 0;
+        call_match(counted1, counted2, counted3,
+            [&](Pointee& x, Pointee& y, Pointee& z) { result = -1; },
+            [&](Pointee& x, nullopt_t, Pointee& z) { result = x.identifier + z.identifier; });
+        REQUIRE(4 == result);
+        REQUIRE(3 == countingPtrTests);
+    }
+}
+#endif
+
+namespace {
+    struct BlocksReclaimer {
+        ~BlocksReclaimer() {
+            entered = true;
+            while (!released) { this_thread::yield(); }
+        }
+
+        static atomic<bool> entered;
+        static atomic<bool> released;
+    };
+
+    atomic<bool> BlocksReclaimer::entered(false);
+    atomic<bool> BlocksReclaimer::released(false);
+}
+
+TEST_CASE("Deferring destruction of a guarded pointee") {
+    TestContext context;
+    reclaimer reclaim(1);
+
+    SECTION("Reset hands the pointee to the reclaimer") {
+        ptr_guard<unique_ptr<Pointee, deferred_delete<Pointee>>> guard(
+            unique_ptr<Pointee, deferred_delete<Pointee>>(new Pointee(1), deferred_delete<Pointee>(reclaim)));
+        guard.reset();
+        REQUIRE(!guard);
+
+        reclaim.drain();
+        REQUIRE(1 == context.pointeeDestructorCalls);
+        reclaimer::statistics stats = reclaim.stats();
+        REQUIRE(1 == stats.deferred);
+        REQUIRE(1 == stats.reclaimed);
+        REQUIRE(0 == stats.depth);
+    }
+    SECTION("Pointees are destroyed inline when the queue is full") {
+        BlocksReclaimer::entered = false;
+        BlocksReclaimer::released = false;
+        deferred_delete<BlocksReclaimer> blocking(reclaim);
+        deferred_delete<Pointee> deleter(reclaim);
+        blocking(new BlocksReclaimer);
+        while (!BlocksReclaimer::entered) { this_thread::yield(); }
+
+        // The object being destroyed still counts against the capacity.
+        REQUIRE(1 == reclaim.stats().depth);
+        deleter(new Pointee);
+        REQUIRE(1 == context.pointeeDestructorCalls);
+        REQUIRE(1 == reclaim.stats().destroyed_inline);
+
+        BlocksReclaimer::released = true;
+        reclaim.drain();
+        REQUIRE(0 == reclaim.stats().depth);
+
+        deleter(new Pointee);
+        reclaim.drain();
+        REQUIRE(2 == context.pointeeDestructorCalls);
+        REQUIRE(1 == reclaim.stats().max_depth);
+    }
+}
+
+TEST_CASE("Deferring destruction through the global reclaimer") {
+    TestContext context;
+    {
+        deferred_unique_guard<Pointee> guard = make_guarded_deferred<Pointee>(1);
+        guard = make_guarded_deferred<Pointee>(2);
+        guard.call([](const Pointee& pointee) { REQUIRE(2 == pointee.identifier); });
+
+        reclaimer::global()->drain();
+        REQUIRE(1 == context.pointeeDestructorCalls);
+    }
+
+    reclaimer::global()->drain();
+    REQUIRE(2 == context.pointeeDestructorCalls);
+}
+
+namespace {
+    struct TrackedPointee : public Pointee, public trackable {
+        TrackedPointee() = default;
+        TrackedPointee(int id) : Pointee(id) { }
+    };
+}
+
+TEST_CASE("Using a ptr_guard<tracked_ptr>") {
+    static_assert(std::is_same<typename ptr_guard<tracked_ptr<TrackedPointee>>::element_type, TrackedPointee>::value, "Element type of tracked_ptr<T> is T");
+
+    SECTION("A default constructed ptr_guard") {
+        ptr_guard<tracked_ptr<TrackedPointee>> guard;
+
+        REQUIRE(!guard);
+        REQUIRE(!pointee_is_accessible(guard));
+    }
+    SECTION("Guards tracking a pointee") {
+        ptr_guard<tracked_ptr<TrackedPointee>> first;
+        ptr_guard<tracked_ptr<TrackedPointee>> second;
+        {
+            TrackedPointee pointee(1);
+            first = &pointee;
+            second = first;
+            ptr_guard<tracked_ptr<const TrackedPointee>> third(&pointee);
+
+            REQUIRE(3 == pointee.tracker_count());
+            REQUIRE(pointee_is_accessible(first));
+            REQUIRE(second == first);
+            second.call([&](TrackedPointee& p) { REQUIRE(&p == &pointee); });
+
+            SECTION("Are untracked when reset.") {
+                first.reset();
+
+                REQUIRE(!first);
+                REQUIRE(2 == pointee.tracker_count());
+            }
+            SECTION("Are untracked when moved from.") {
+                ptr_guard<tracked_ptr<TrackedPointee>> moved(std::move(second));
+
+                REQUIRE(moved);
+                REQUIRE(3 == pointee.tracker_count());
+            }
+            SECTION("Stay with the original pointee when it is copied.") {
+                TrackedPointee copy(pointee);
+
+                REQUIRE(0 == copy.tracker_count());
+                REQUIRE(3 == pointee.tracker_count());
+            }
+        }
+
+        REQUIRE(!first);
+        REQUIRE(!second);
+        REQUIRE(!pointee_is_accessible(second));
+        REQUIRE(0 == second.call_or([](TrackedPointee& p) { return p.identifier; }, 0));
+    }
+    SECTION("Are untracked by untrack_all before the target is destroyed.") {
+        TrackedPointee pointee(1);
+        ptr_guard<tracked_ptr<TrackedPointee>> first(&pointee);
+        ptr_guard<tracked_ptr<TrackedPointee>> second(&pointee);
+        pointee.untrack_all();
+
+        REQUIRE(!first);
+        REQUIRE(!second);
+        REQUIRE(0 == pointee.tracker_count());
+
+        first = &pointee;
+        REQUIRE(1 == pointee.tracker_count());
+    }
+}
+
+namespace {
+    const void* lastDanglingPointee = nullptr;
+
+    void record_dangling_pointee(const void* pointee) { lastDanglingPointee = pointee; }
+}
+
+TEST_CASE("Using a ptr_guard<generation_ptr>") {
+    static_assert(std::is_same<typename ptr_guard<generation_ptr<Pointee>>::element_type, Pointee>::value, "Element type of generation_ptr<T> is T");
+    static_assert(std::is_trivially_copyable<generation_ptr<Pointee>>::value, "A generation_ptr is trivially copyable");
+
+    TestContext context;
+    lastDanglingPointee = nullptr;
+    dangling_pointer_handler previous = set_dangling_pointer_handler(&record_dangling_pointee);
+
+    SECTION("A default constructed ptr_guard") {
+        ptr_guard<generation_ptr<Pointee>> guard;
+
+        REQUIRE(!guard);
+        REQUIRE(!pointee_is_accessible(guard));
+        REQUIRE(nullptr == lastDanglingPointee);
+    }
+    SECTION("Guards of a destroyed pointee") {
+        generation_ptr<Pointee> owner = make_generation_ptr<Pointee>(1);
+        generation_ptr<Pointee> copy = owner;
+        const void* address = owner.get();
+        ptr_guard<generation_ptr<Pointee>> stale(owner);
+
+        REQUIRE(1 == stale.call_or([](Pointee& p) { return p.identifier; }, 0));
+        destroy_generation_ptr(owner);
+
+        REQUIRE(!owner);
+        REQUIRE(1 == context.pointeeDestructorCalls);
+        REQUIRE(!pointee_is_accessible(stale));
+        REQUIRE(address == lastDanglingPointee);
+
+        SECTION("Stay dangling when the memory is reused.") {
+            generation_ptr<Pointee> reused = make_generation_ptr<Pointee>(2);
+
+            REQUIRE(address == reused.get());
+            REQUIRE(0 == stale.call_or([](Pointee& p) { return p.identifier; }, 0));
+            REQUIRE(2 == ptr_guard<generation_ptr<Pointee>>(reused).call_or([](Pointee& p) { return p.identifier; }, 0));
+            destroy_generation_ptr(reused);
+        }
+        SECTION("Are not destroyed twice.") {
+            int destroyed = context.pointeeDestructorCalls;
+            destroy_generation_ptr(copy);
+
+            REQUIRE(destroyed == context.pointeeDestructorCalls);
+        }
+    }
+    SECTION("Converting to a guard of a base") {
+        generation_ptr<DerivedFromPointee> derived = make_generation_ptr<DerivedFromPointee>();
+        generation_ptr<Pointee> base = derived;
+        ptr_guard<generation_ptr<Pointee>> guard(base);
+
+        REQUIRE(guard);
+        destroy_generation_ptr(base);
+
+        REQUIRE(1 == context.pointeeDestructorCalls);
+        REQUIRE(derived.dangling());
+        REQUIRE(!guard);
+    }
+    SECTION("A checked_guard") {
+        checked_guard<Pointee> guard = make_checked_guard<Pointee>(3);
+
+        REQUIRE(3 == guard.call_or([](Pointee& p) { return p.identifier; }, 0));
+        destroy_checked_guard(guard);
+
+        REQUIRE(1 == context.pointeeDestructorCalls);
+        REQUIRE(!guard);
+    }
+
+    set_dangling_pointer_handler(previous);
+}
+
+namespace {
+    int identifier_through_views(guard_ref<const Pointee> pointee, int depth) {
+        if (depth) { return identifier_through_views(pointee, depth - 1); }
+        return pointee.call_or([](const Pointee& p) { return p.identifier; }, -1);
+    }
+}
+
+TEST_CASE("Borrowing a guard_ref from an owning guard") {
+    static_assert(std::is_trivially_copyable<guard_ref<Pointee>>::value, "A guard_ref is trivially copyable");
+    static_assert(std::is_same<guard_ref<Pointee>, ptr_guard<Pointee*>>::value, "A guard_ref is a ptr_guard<T*>");
+    static_assert(!std::is_constructible<guard_ref<Pointee>, ptr_guard<shared_ptr<Pointee>>&&>::value,
+                  "A guard_ref is not constructed from a temporary owning guard");
+    static_assert(!std::is_assignable<guard_ref<Pointee>&, ptr_guard<unique_ptr<Pointee>>&&>::value,
+                  "A guard_ref is not assigned from a temporary owning guard");
+    static_assert(std::is_constructible<guard_ref<Pointee>, ptr_guard<shared_ptr<Pointee>>&>::value,
+                  "A guard_ref is constructed from an owning guard");
+    static_assert(std::is_constructible<guard_ref<const Pointee>, guard_ref<Pointee>&&>::value,
+                  "A guard_ref is constructed from a temporary guard_ref");
+
+    SECTION("From a ptr_guard<shared_ptr> without sharing ownership.") {
+        ptr_guard<shared_ptr<Pointee>> owner(make_shared<Pointee>(3));
+        guard_ref<Pointee> view(owner);
+
+        REQUIRE(1 == owner.use_count());
+        REQUIRE(3 == identifier_through_views(owner, 8));
+        view.call([&](Pointee& p) { owner.call([&](Pointee& q) { REQUIRE(&p == &q); }); });
+    }
+    SECTION("From a ptr_guard<unique_ptr>.") {
+        ptr_guard<unique_ptr<Pointee>> owner(unique_ptr<Pointee>(new Pointee(4)));
+        guard_ref<const Pointee> view;
+        view = owner;
+
+        REQUIRE(view);
+        REQUIRE(4 == identifier_through_views(view, 2));
+    }
+    SECTION("From a null guard.") {
+        ptr_guard<shared_ptr<Pointee>> owner;
+        guard_ref<Pointee> view(owner);
+
+        REQUIRE(!view);
+        REQUIRE(-1 == identifier_through_views(owner, 2));
+    }
+#ifdef __CPP17_SUPPORT__
+    SECTION("From an inline_guard.") {
+        inline_guard<Pointee> owner = make_guarded_inline<Pointee>(5);
+
+        REQUIRE(5 == identifier_through_views(owner, 2));
+        owner.reset();
+        REQUIRE(-1 == identifier_through_views(owner, 2));
+    }
+#endif
+}
+
+TEST_CASE("Using a ptr_guard<sharded_shared_ptr>") {
+    static_assert(std::is_same<typename ptr_guard<sharded_shared_ptr<Pointee>>::element_type, Pointee>::value, "Element type of sharded_shared_ptr<T> is T");
+
+    SECTION("A default constructed ptr_guard") {
+        ptr_guard<sharded_shared_ptr<Pointee>> guard;
+
+        REQUIRE(!guard);
+        REQUIRE(0 == guard.use_count());
+        REQUIRE(!pointee_is_accessible(guard));
+    }
+    SECTION("Copies share the pointee") {
+        TestContext context;
+        {
+            ptr_guard<sharded_shared_ptr<Pointee>> guard(make_sharded_shared<Pointee>(1));
+            ptr_guard<sharded_shared_ptr<const Pointee>> copy(guard);
+
+            REQUIRE(2 == guard.use_count());
+            copy.call([](const Pointee& p) { REQUIRE(1 == p.identifier); });
+
+            guard.reset();
+            REQUIRE(!guard);
+            REQUIRE(0 == context.pointeeDestructorCalls);
+        }
+        REQUIRE(1 == context.pointeeDestructorCalls);
+    }
+    SECTION("Copies made and released on many threads destroy the pointee once") {
+        TestContext context;
+        {
+            ptr_guard<sharded_shared_ptr<Pointee>> guard(new Pointee(2));
+            vector<thread> threads;
+            atomic<int> sum(0);
+            for (int t = 0; t < 4; ++t) {
+                threads.emplace_back([&] {
+                    ptr_guard<sharded_shared_ptr<Pointee>> local(guard);
+                    for (int i = 0; i < 10000; ++i) {
+                        ptr_guard<sharded_shared_ptr<Pointee>> copy(local);
+                        copy.call([&](Pointee& p) { sum += p.identifier; });
+                    }
+                });
+            }
+            for (thread& t : threads) { t.join(); }
+
+            REQUIRE(80000 == sum);
+            REQUIRE(1 == guard.use_count());
+            REQUIRE(0 == context.pointeeDestructorCalls);
+        }
+        REQUIRE(1 == context.pointeeDestructorCalls);
+    }
+}
+
+#ifdef __CPP17_SUPPORT__
+namespace {
+    struct TransparentStringHash {
+        typedef void is_transparent;
+        size_t operator ()(std::string_view s) const noexcept { return hash<std::string_view>()(s); }
+    };
+}
+#endif
+
+TEST_CASE("Guarded lookup in associative containers") {
+    SECTION("In a std::map") {
+        map<int, Pointee> values;
+        values.emplace(1, Pointee(10));
+
+        ptr_guard<Pointee*> found = find_guarded(values, 1);
+        REQUIRE(found);
+        found.call([](Pointee& p) { p.identifier = 11; });
+        REQUIRE(11 == values[1].identifier);
+        REQUIRE(!find_guarded(values, 2));
+
+        const map<int, Pointee>& constValues = values;
+        ptr_guard<const Pointee*> constFound = find_guarded(constValues, 1);
+        REQUIRE(constFound);
+    }
+    SECTION("In a std::unordered_map") {
+        unordered_map<string, int> values{ { "one", 1 }, { "two", 2 } };
+
+        REQUIRE(2 == find_guarded(values, string("two")).call_or([](int v) { return v; }, 0));
+        REQUIRE(!find_guarded(values, string("three")));
+    }
+#ifdef __CPP17_SUPPORT__
+    SECTION("With a heterogeneous key") {
+        map<string, int, less<>> values{ { "one", 1 } };
+
+        REQUIRE(find_guarded(values, std::string_view("one")));
+        REQUIRE(!find_guarded(values, std::string_view("two")));
+
+        guard_flat_map<string, int, TransparentStringHash, equal_to<>> flat;
+        flat["one"] = 1;
+        REQUIRE(flat.contains(std::string_view("one")));
+        REQUIRE(1 == find_guarded(flat, std::string_view("one")).call_or([](int v) { return v; }, 0));
+        REQUIRE(!find_guarded(flat, std::string_view("two")));
+    }
+#endif
+    SECTION("Of a batch of keys in a guard_flat_map") {
+        typedef ptr_guard<shared_ptr<Pointee>> Key;
+        guard_flat_map<Key, int> values;
+        vector<Key> keys;
+        for (int i = 0; i < 100; ++i) {
+            keys.push_back(Key(new Pointee(i)));
+            if (i % 3) { values[keys.back()] = i; }
+        }
+
+        vector<ptr_guard<int*>> found;
+        find_guarded(values, keys.begin(), keys.end(), back_inserter(found));
+
+        REQUIRE(100 == found.size());
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE((i % 3 ? i : -1) == found[i].call_or([](int v) { return v; }, -1));
+        }
+    }
+}
+
+namespace {
+    int add_one(int value) { return value + 1; }
+
+    int apply_callback(guarded_function_ref<int(int)> callback, int value) {
+        return callback.call_or(-1, value);
+    }
+}
+
+TEST_CASE("Calling a guarded_function") {
+    static_assert(sizeof(guarded_function<void()>) <= guarded_function<void()>::capacity + alignof(max_align_t), "A guarded_function stores its callable inline");
+    static_assert(std::is_trivially_copyable<guarded_function_ref<void()>>::value, "A guarded_function_ref is trivially copyable");
+
+    SECTION("An empty guarded_function is skipped") {
+        guarded_function<int(int)> callback;
+        REQUIRE(!callback);
+        callback.call(1);
+        REQUIRE(-1 == callback.call_or(-1, 1));
+
+        int (*nullFunction)(int) = nullptr;
+        callback = nullFunction;
+        REQUIRE(!callback);
+    }
+    SECTION("A guarded_function holding a lambda") {
+        int calls = 0;
+        guarded_function<int(int)> callback = [&calls](int value) { ++calls; return value * 2; };
+
+        REQUIRE(callback);
+        callback.call(1);
+        REQUIRE(6 == callback.call_or(-1, 3));
+        REQUIRE(2 == calls);
+
+        SECTION("Is copied and moved with its callable.") {
+            guarded_function<int(int)> copy(callback);
+            guarded_function<int(int)> moved(std::move(callback));
+
+            REQUIRE(!callback);
+            REQUIRE(8 == copy.call_or(-1, 4));
+            REQUIRE(10 == moved.call_or(-1, 5));
+        }
+        SECTION("Is emptied by reset.") {
+            callback.reset();
+
+            REQUIRE(-1 == callback.call_or(-1, 3));
+            REQUIRE(2 == calls);
+        }
+    }
+    SECTION("A guarded_function destroys its callable") {
+        TestContext context;
+        {
+            shared_ptr<Pointee> pointee = make_shared<Pointee>(7);
+            guarded_function<int()> callback = [pointee] { return pointee->identifier; };
+            guarded_function<int()> copy = callback;
+            pointee.reset();
+
+            REQUIRE(7 == copy.call_or(0));
+            callback = nullptr;
+            REQUIRE(0 == context.pointeeDestructorCalls);
+        }
+        REQUIRE(1 == context.pointeeDestructorCalls);
+    }
+    SECTION("A guarded_function_ref") {
+        REQUIRE(-1 == apply_callback(nullptr, 1));
+        REQUIRE(2 == apply_callback(add_one, 1));
+        REQUIRE(2 == apply_callback(&add_one, 1));
+
+        auto triple = [](int value) { return value * 3; };
+        REQUIRE(3 == apply_callback(triple, 1));
+
+        guarded_function<int(int)> owned = triple;
+        REQUIRE(6 == apply_callback(owned, 2));
+        owned.reset();
+        REQUIRE(-1 == apply_callback(owned, 2));
+    }
+}
+
+TEST_CASE("Dispatching to an observer_list") {
+    observer_list<Pointee> listeners;
+    vector<shared_ptr<Pointee>> owners;
+    for (int i = 0; i < 10; ++i) {
+        owners.push_back(make_shared<Pointee>(i));
+        listeners.add(owners.back());
+    }
+
+    int sum = 0;
+    auto add_identifier = [&](Pointee& p, int scale) { sum += scale * p.identifier; };
+    REQUIRE(10 == listeners.dispatch(add_identifier, 1));
+    REQUIRE(45 == sum);
+
+    SECTION("Expired listeners are skipped and compacted") {
+        for (int i = 0; i < 10; i += 2) { owners[i].reset(); }
+        REQUIRE(10 == listeners.size());
+
+        sum = 0;
+        REQUIRE(5 == listeners.dispatch(add_identifier, 2));
+        REQUIRE(50 == sum);
+        REQUIRE(5 == listeners.size());
+    }
+    SECTION("Listeners added during a dispatch are called by the next one") {
+        shared_ptr<Pointee> added = make_shared<Pointee>(100);
+        REQUIRE(10 == listeners.dispatch([&](Pointee& p) { if (p.identifier == 3) { listeners.add(added); } }));
+        REQUIRE(11 == listeners.size());
+
+        sum = 0;
+        REQUIRE(11 == listeners.dispatch(add_identifier, 1));
+        REQUIRE(145 == sum);
+    }
+    SECTION("Listeners removed during a dispatch are not called by it") {
+        vector<int> called;
+        listeners.dispatch([&](Pointee& p) {
+            called.push_back(p.identifier);
+            if (p.identifier == 2) { listeners.remove(owners[5]); }
+        });
+        REQUIRE(9 == called.size());
+        REQUIRE(9 == listeners.size());
+        REQUIRE_FALSE(listeners.remove(owners[5]));
+    }
+    SECTION("A nested dispatch calls each listener once") {
+        owners[0].reset();
+        owners[4].reset();
+        size_t nested = 0;
+        listeners.dispatch([&](Pointee& p) {
+            if (p.identifier == 6) { nested = listeners.dispatch([](Pointee&) { }); }
+        });
+        REQUIRE(8 == nested);
+        REQUIRE(8 == listeners.size());
+    }
+}
+
+TEST_CASE("An observer_list of tracked_ptr listeners") {
+    observer_list<TrackedPointee, tracked_ptr<TrackedPointee>> listeners;
+    TrackedPointee first(1);
+    {
+        TrackedPointee second(2);
+        listeners.add(&first);
+        listeners.add(&second);
+        REQUIRE(2 == listeners.dispatch([](TrackedPointee&) { }));
+    }
+    REQUIRE(1 == listeners.dispatch([](TrackedPointee& p) { REQUIRE(1 == p.identifier); }));
+    REQUIRE(1 == listeners.size());
+}
+
+TEST_CASE("Pinning a range of ptr_guard<weak_ptr>") {
+    vector<shared_ptr<Pointee>> owners{ make_shared<Pointee>(1), make_shared<Pointee>(2), make_shared<Pointee>(3) };
+    vector<ptr_guard<weak_ptr<Pointee>>> guards(owners.begin(), owners.end());
+    guards.emplace_back();
+    owners[1].reset();
+
+    pinned_snapshot<Pointee> pinned = pin_all(guards);
+
+    REQUIRE(2 == pinned.size());
+    REQUIRE(2 == pinned.expired());
+    REQUIRE(2 == owners[0].use_count());
+
+    SECTION("Calls each live pointee in order") {
+        vector<int> identifiers;
+        REQUIRE(2 == pinned.call([&](Pointee& p) { identifiers.push_back(p.identifier); }));
+        REQUIRE(vector<int>{ 1, 3 } == identifiers);
+    }
+    SECTION("Keeps pointees alive until released") {
+        weak_ptr<Pointee> observer = owners[2];
+        owners[2].reset();
+
+        REQUIRE(!observer.expired());
+        pinned.release();
+
+        REQUIRE(observer.expired());
+        REQUIRE(pinned.empty());
+    }
+    SECTION("Passes dereferenced guards after the pointee") {
+        int sum = 0;
+        ptr_guard<int*> total(&sum);
+        pinned.call([](Pointee& p, int& total) { total += p.identifier; }, total);
+        REQUIRE(4 == sum);
+
+        REQUIRE(0 == pinned.call([](Pointee&, int&) { }, ptr_guard<int*>()));
+    }
+    SECTION("Is pinned again by assign") {
+        owners[0].reset();
+        pinned.assign(guards.begin(), guards.end());
+
+        REQUIRE(1 == pinned.size());
+        REQUIRE(3 == pinned.expired());
+    }
+}
+
+namespace {
+    // Looks itself up in its cache when destroyed, which deadlocks if destroyed under the lock.
+    struct CacheReentrant {
+        guarded_cache<int, CacheReentrant>* cache;
+        int key;
+
+        ~CacheReentrant() { cache->find(key); }
+    };
+}
+
+TEST_CASE("Values of a guarded_cache are destroyed outside its lock") {
+    guarded_cache<int, CacheReentrant> cache(1, 1);
+    cache.insert(1, make_shared<CacheReentrant>(CacheReentrant{ &cache, 1 }));
+    cache.insert(2, make_shared<CacheReentrant>(CacheReentrant{ &cache, 1 }));
+
+    REQUIRE(!cache.find(1));
+    REQUIRE(cache.erase(2));
+    cache.insert(3, make_shared<CacheReentrant>(CacheReentrant{ &cache, 3 }));
+    cache.insert(3, make_shared<CacheReentrant>(CacheReentrant{ &cache, 1 }));
+    cache.clear();
+    REQUIRE(0 == cache.size());
+}
+
+TEST_CASE("Looking up values in a guarded_cache") {
+    guarded_cache<int, Pointee> cache(2, 1);
+    int loads = 0;
+    auto load = [&](int key) { ++loads; return make_shared<Pointee>(key); };
+
+    REQUIRE(!cache.find(1));
+    REQUIRE(cache.find_or_load(1, load));
+    REQUIRE(cache.find_or_load(2, load));
+    REQUIRE(cache.find_or_load(1, load));
+    REQUIRE(2 == loads);
+
+    SECTION("Evicted values no longer in use are dropped") {
+        cache.insert(3, make_shared<Pointee>(3));
+
+        REQUIRE(!cache.find(2));
+        REQUIRE(cache.find(1));
+        REQUIRE(cache.find(3));
+        REQUIRE(2 == cache.size());
+    }
+    SECTION("Evicted values still in use are revived without loading") {
+        ptr_guard<shared_ptr<Pointee>> held = cache.find(2);
+        cache.insert(3, make_shared<Pointee>(3));
+        cache.insert(4, make_shared<Pointee>(4));
+
+        REQUIRE(3 == cache.size());
+        ptr_guard<shared_ptr<Pointee>> revived = cache.find_or_load(2, load);
+        REQUIRE(revived == held);
+        REQUIRE(2 == loads);
+        revived.call([](Pointee& p) { REQUIRE(2 == p.identifier); });
+    }
+    SECTION("Erased values are not found") {
+        REQUIRE(cache.erase(1));
+        REQUIRE_FALSE(cache.erase(1));
+        REQUIRE(!cache.find(1));
+        REQUIRE(cache.find(2));
+    }
+}
+
+TEST_CASE("Loading values into a guarded_cache from many threads") {
+    guarded_cache<int, Pointee> cache(64);
+    atomic<int> loads(0);
+    vector<thread> threads;
+    atomic<bool> correct(true);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 2000; ++i) {
+                int key = (i * 7 + t) % 100;
+                ptr_guard<shared_ptr<Pointee>> value = cache.find_or_load(key, [&](int k) {
+                    ++loads;
+                    return make_shared<Pointee>(k);
+                });
+                if (!value.call_or([&](Pointee& p) { return p.identifier == key; }, false)) { correct = false; }
+            }
+        });
+    }
+    for (thread& t : threads) { t.join(); }
+
+    REQUIRE(correct);
+    REQUIRE(100 <= loads);
+    REQUIRE(64 >= cache.size());
+}
+
+namespace {
+    struct TaggedNode {
+        int value = 0;
+        ptr_guard<tagged_ptr<TaggedNode, 2>> left;
+        ptr_guard<tagged_ptr<TaggedNode, 2>> right;
+    };
+}
+
+TEST_CASE("Using a ptr_guard<tagged_ptr>") {
+    static_assert(std::is_same<typename ptr_guard<tagged_ptr<Pointee, 2>>::element_type, Pointee>::value, "Element type of tagged_ptr<T, Bits> is T");
+    static_assert(sizeof(ptr_guard<tagged_ptr<Pointee, 2>>) == sizeof(Pointee*), "A tagged_ptr is the size of a pointer");
+
+    SECTION("A default constructed ptr_guard") {
+        ptr_guard<tagged_ptr<Pointee, 2>> guard;
+
+        REQUIRE(!guard);
+        REQUIRE(0 == get_tag(guard));
+        REQUIRE(!pointee_is_accessible(guard));
+    }
+    SECTION("A null ptr_guard with a tag is still null") {
+        ptr_guard<tagged_ptr<Pointee, 2>> guard;
+        set_tag(guard, 3);
+
+        REQUIRE(!guard);
+        REQUIRE(3 == get_tag(guard));
+    }
+    SECTION("A ptr_guard constructed with a non null pointer") {
+        Pointee pointee(4);
+        ptr_guard<tagged_ptr<Pointee, 2>> guard(&pointee);
+        set_tag(guard, 2);
+
+        REQUIRE(guard);
+        REQUIRE(2 == get_tag(guard));
+        REQUIRE(pointee_is_accessible(guard));
+        guard.call([&](Pointee& p) { REQUIRE(&p == &pointee); });
+        REQUIRE(guard == ptr_guard<tagged_ptr<Pointee, 2>>(&pointee));
+
+        SECTION("Tags wider than the tag bits are truncated.") {
+            set_tag(guard, 5);
+            REQUIRE(1 == get_tag(guard));
+        }
+        SECTION("Reset keeps the tag.") {
+            guard.reset();
+
+            REQUIRE(!guard);
+            REQUIRE(2 == get_tag(guard));
+        }
+    }
+    SECTION("Traversing a tree of tagged nodes") {
+        TaggedNode leaves[2];
+        leaves[0].value = 1;
+        leaves[1].value = 2;
+        TaggedNode root;
+        root.value = 3;
+        root.left = &leaves[0];
+        root.right = &leaves[1];
+        set_tag(root.right, 1);
+
+        int sum = root.value;
+        root.left.call([&](TaggedNode& n) { sum += n.value; });
+        root.right.call([&](TaggedNode& n) { sum += n.value; });
+        REQUIRE(6 == sum);
+        REQUIRE(0 == get_tag(root.left));
+        REQUIRE(1 == get_tag(root.right));
+    }
+}
+
+TEST_CASE("Copy on write through a cow_guard") {
+    SECTION("A default constructed cow_guard") {
+        cow_guard<Pointee> guard;
+
+        REQUIRE(!guard);
+        REQUIRE(-1 == guard.call_or([](const Pointee& p) { return p.identifier; }, -1));
+        REQUIRE(-1 == guard.call_mut_or([](Pointee& p) { return p.identifier; }, -1));
+    }
+    SECTION("A cow_guard which is not shared is mutated in place") {
+        cow_guard<Pointee> guard = make_cow_guard<Pointee>(1);
+        const Pointee* before = nullptr;
+        guard.call([&](const Pointee& p) { before = &p; });
+
+        guard.call_mut([](Pointee& p) { p.identifier = 2; });
+
+        REQUIRE(1 == guard.use_count());
+        guard.call([&](const Pointee& p) {
+            REQUIRE(&p == before);
+            REQUIRE(2 == p.identifier);
+        });
+    }
+    SECTION("A shared cow_guard is cloned before mutation") {
+        cow_guard<Pointee> guard = make_cow_guard<Pointee>(1);
+        cow_guard<Pointee> copy = guard;
+        REQUIRE(2 == guard.use_count());
+
+        copy.call([&](const Pointee& c) { guard.call([&](const Pointee& g) { REQUIRE(&c == &g); }); });
+
+        copy.call_mut([](Pointee& p, int value) { p.identifier = value; }, 3);
+
+        REQUIRE(1 == guard.use_count());
+        REQUIRE(1 == copy.use_count());
+        REQUIRE(1 == guard.call_or([](const Pointee& p) { return p.identifier; }, -1));
+        REQUIRE(3 == copy.call_or([](const Pointee& p) { return p.identifier; }, -1));
+    }
+    SECTION("Other guards are dereferenced for the call") {
+        cow_guard<Pointee> guard = make_cow_guard<Pointee>(4);
+        Pointee other(5);
+        ptr_guard<Pointee*> otherGuard(&other);
+
+        REQUIRE(9 == guard.call_or([](const Pointee& p, Pointee& o) { return p.identifier + o.identifier; }, -1, otherGuard));
+        otherGuard = nullptr;
+        REQUIRE(-1 == guard.call_or([](const Pointee& p, Pointee& o) { return p.identifier + o.identifier; }, -1, otherGuard));
+    }
+}
+
+TEST_CASE("Making guarded unique and shared pointers") {
+    ptr_guard<unique_ptr<Pointee>> unique = make_guarded_unique<Pointee>(1);
+    ptr_guard<shared_ptr<Pointee>> shared = make_guarded_shared<Pointee>(2);
+
+    REQUIRE(1 == unique.call_or([](Pointee& p) { return p.identifier; }, 0));
+    REQUIRE(2 == shared.call_or([](Pointee& p) { return p.identifier; }, 0));
+}
+
+struct FailsToAllocate {
+    static void* operator new(std::size_t, std::nothrow_t const&) noexcept { return nullptr; }
+    int identifier = 1;
+};
+
+TEST_CASE("Making guards without throwing") {
+    SECTION("The nothrow factories make valid guards") {
+        ptr_guard<unique_ptr<Pointee>> unique = make_guarded_unique_nothrow<Pointee>(1);
+        ptr_guard<shared_ptr<Pointee>> shared = make_guarded_shared_nothrow<Pointee>(2);
+        ptr_guard<Pointee*> raw = make_guarded_nothrow<Pointee>(3);
+
+        REQUIRE(1 == unique.call_or([](Pointee& p) { return p.identifier; }, 0));
+        REQUIRE(2 == shared.call_or([](Pointee& p) { return p.identifier; }, 0));
+        REQUIRE(3 == raw.call_or([](Pointee& p) { return p.identifier; }, 0));
+        raw.call([](Pointee& p) { delete &p; });
+    }
+    SECTION("A failed allocation makes a null guard") {
+        REQUIRE(!make_guarded_nothrow<FailsToAllocate>());
+        REQUIRE(!make_guarded_unique_nothrow<FailsToAllocate>());
+    }
+    SECTION("Calls are noexcept when the callable is") {
+        ptr_guard<unique_ptr<Pointee>> guard;
+        ptr_guard<Pointee*> other;
+        auto nothrowCall = [](Pointee& p) noexcept { return p.identifier; };
+        auto nothrowPairCall = [](Pointee&, Pointee&, int) noexcept { };
+        auto nothrowName = [](Pointee&) noexcept { return std::string(); };
+        auto throwingCall = [](Pointee& p) { return p.identifier; };
+
+        static_assert(noexcept(guard.call(nothrowCall)), "A call of a noexcept callable is noexcept");
+        static_assert(noexcept(guard.call_or(nothrowCall, 0)), "A call_or of a noexcept callable is noexcept");
+        static_assert(noexcept(guard.call(nothrowPairCall, other, 1)), "Guard arguments do not prevent noexcept");
+        static_assert(!noexcept(guard.call(throwingCall)), "A call of a throwing callable is not noexcept");
+        static_assert(!noexcept(guard.call_or(throwingCall, 0)), "A call_or of a throwing callable is not noexcept");
+        static_assert(!noexcept(guard.call_or(nothrowName, std::string())), "A call_or copying a throwing default is not noexcept");
+
+        REQUIRE(-1 == guard.call_or(nothrowCall, -1));
+    }
+}
+
+struct Shape {
+    virtual ~Shape() = default;
+    virtual int sides() const = 0;
+};
+
+struct Triangle final : Shape {
+    int sides() const override { return 3; }
+};
+
+struct Square final : Shape {
+    int sides() const override { return 4; }
+};
+
+struct Hexagon final : Shape {
+    int sides() const override { return 6; }
+};
+
+TEST_CASE("Calling on guards grouped by type") {
+    vector<ptr_guard<unique_ptr<Shape>>> shapes;
+    for (int i = 0; i < 12; ++i) {
+        switch (i % 4) {
+        case 0: shapes.emplace_back(make_unique<Square>()); break;
+        case 1: shapes.emplace_back(make_unique<Triangle>()); break;
+        case 2: shapes.emplace_back(make_unique<Hexagon>()); break;
+        default: shapes.emplace_back(nullptr); break;
+        }
+    }
+
+    SECTION("Each type is called as its concrete type, one type after another") {
+        vector<int> calls;
+        size_t called = call_by_type<Triangle, Square>(shapes.begin(), shapes.end(), [&](auto& shape) {
+            typedef typename std::decay<decltype(shape)>::type type;
+            int kind = std::is_same<type, Triangle>::value ? 1 : std::is_same<type, Square>::value ? 2 : 0;
+            calls.push_back(kind * 10 + shape.sides());
+        });
+
+        REQUIRE(9 == called);
+        REQUIRE(vector<int>{ 13, 13, 13, 24, 24, 24, 6, 6, 6 } == calls);
+    }
+    SECTION("Buckets are kept between dispatches") {
+        type_buckets<Shape, Hexagon> buckets(shapes.begin(), shapes.end());
+        int total = 0;
+
+        REQUIRE(9 == buckets.size());
+        buckets.call([&](const Shape& shape) { total += shape.sides(); });
+        REQUIRE(39 == total);
+
+        buckets.assign(shapes.begin(), shapes.begin() + 3);
+        REQUIRE(3 == buckets.size());
+        buckets.clear();
+        REQUIRE(buckets.empty());
+        REQUIRE(0 == buckets.call([](Shape&) { }));
+    }
+}
+
+struct ThreadScratch {
+    static atomic<int> destroyed;
+
+    ~ThreadScratch() { ++destroyed; }
+
+    int uses = 0;
+};
+
+atomic<int> ThreadScratch::destroyed(0);
+
+TEST_CASE("Using a tls_guard") {
+    ThreadScratch::destroyed = 0;
+
+    SECTION("Each thread is given an instance of its own") {
+        tls_guard<ThreadScratch> scratch;
+        auto use = [&] {
+            for (int i = 0; i < 100; ++i) { scratch.call([](ThreadScratch& s) { ++s.uses; }); }
+        };
+        use();
+        thread first(use);
+        thread second(use);
+        first.join();
+        second.join();
+
+        REQUIRE(2 == ThreadScratch::destroyed);
+        int total = 0;
+        REQUIRE(1 == scratch.for_each([&](ThreadScratch const& s) { total += s.uses; }));
+        REQUIRE(100 == total);
+        REQUIRE(100 == scratch.call_or([](ThreadScratch& s) { return s.uses; }, -1));
+
+        scratch.reset();
+        REQUIRE(3 == ThreadScratch::destroyed);
+        REQUIRE(0 == scratch.call_or([](ThreadScratch& s) { return s.uses; }, -1));
+    }
+    SECTION("The instances of all live threads are visited") {
+        tls_guard<ThreadScratch> scratch;
+        std::mutex lock;
+        std::condition_variable changed;
+        int ready = 0;
+        bool done = false;
+        vector<thread> threads;
+        for (int t = 0; t < 3; ++t) {
+            threads.emplace_back([&, t] {
+                scratch.call([t](ThreadScratch& s) { s.uses = t + 1; });
+                std::unique_lock<std::mutex> held(lock);
+                ++ready;
+                changed.notify_all();
+                changed.wait(held, [&] { return done; });
+            });
+        }
+        {
+            std::unique_lock<std::mutex> held(lock);
+            changed.wait(held, [&] { return ready == 3; });
+        }
+
+        int total = 0;
+        REQUIRE(3 == scratch.for_each([&](ThreadScratch const& s) { total += s.uses; }));
+        REQUIRE(6 == total);
+
+        {
+            std::lock_guard<std::mutex> held(lock);
+            done = true;
+        }
+        changed.notify_all();
+        for (thread& t : threads) { t.join(); }
+        REQUIRE(3 == ThreadScratch::destroyed);
+        REQUIRE(0 == scratch.for_each([](ThreadScratch const&) { }));
+    }
+    SECTION("Destroying the guard destroys the instances of live threads") {
+        auto scratch = make_unique<tls_guard<ThreadScratch>>();
+        std::mutex lock;
+        std::condition_variable changed;
+        int stage = 0;
+        thread worker([&] {
+            scratch->call([](ThreadScratch& s) { ++s.uses; });
+            std::unique_lock<std::mutex> held(lock);
+            stage = 1;
+            changed.notify_all();
+            changed.wait(held, [&] { return stage == 2; });
+        });
+        {
+            std::unique_lock<std::mutex> held(lock);
+            changed.wait(held, [&] { return stage == 1; });
+        }
+        scratch.reset();
+        REQUIRE(1 == ThreadScratch::destroyed);
+        {
+            std::lock_guard<std::mutex> held(lock);
+            stage = 2;
+        }
+        changed.notify_all();
+        worker.join();
+        REQUIRE(1 == ThreadScratch::destroyed);
+    }
+    SECTION("A factory returning null leaves the guard null") {
+        int attempts = 0;
+        auto factory = [&attempts] { ++attempts; return unique_ptr<ThreadScratch>(); };
+        tls_guard<ThreadScratch, decltype(factory)> scratch(factory);
+
+        REQUIRE(-1 == scratch.call_or([](ThreadScratch& s) { return s.uses; }, -1));
+        REQUIRE(-1 == scratch.call_or([](ThreadScratch& s) { return s.uses; }, -1));
+        REQUIRE(2 == attempts);
+    }
+}
+
+struct SequencedPair {
+    int first = 0;
+    int second = 0;
+};
+
+namespace {
+    template <class Queue>
+    void check_guard_queue() {
+        TestContext context;
+        typedef typename Queue::guard_type guard_type;
+        {
+            Queue queue(3);
+            REQUIRE(4 == queue.capacity());
+            REQUIRE(!queue.try_pop());
+
+            guard_type empty;
+            REQUIRE(queue.try_push(empty));
+            REQUIRE(!queue.try_pop());
+
+            vector<guard_type> pushed;
+            for (int i = 1; i <= 5; ++i) { pushed.emplace_back(make_unique<Pointee>(i)); }
+            REQUIRE(4 == queue.try_push(pushed.begin(), pushed.end()));
+            REQUIRE(!pushed[3]);
+            REQUIRE(pushed[4]);
+            REQUIRE(!queue.try_push(pushed[4]));
+            REQUIRE(pushed[4]);
+
+            REQUIRE(1 == queue.try_pop().call_or([](Pointee& p) { return p.identifier; }, 0));
+            REQUIRE(queue.try_push(pushed[4]));
+
+            vector<guard_type> popped;
+            REQUIRE(2 == queue.try_pop(back_inserter(popped), 2));
+            REQUIRE(2 == popped[0].call_or([](Pointee& p) { return p.identifier; }, 0));
+            REQUIRE(3 == popped[1].call_or([](Pointee& p) { return p.identifier; }, 0));
+            REQUIRE(1 == context.pointeeDestructorCalls);
+        }
+        // The two guards still queued are destroyed with the queue.
+        REQUIRE(5 == context.pointeeDestructorCalls);
+    }
+
+    template <class Queue>
+    void check_guard_queue_across_threads(int producers) {
+        const int perProducer = 10000;
+        Queue queue(64);
+        vector<thread> threads;
+        for (int t = 0; t < producers; ++t) {
+            threads.emplace_back([&queue, t] {
+                for (int i = 0; i < perProducer; ++i) {
+                    typename Queue::guard_type guard(make_unique<int>(t * perProducer + i));
+                    while (!queue.try_push(guard)) { this_thread::yield(); }
+                }
+            });
+        }
+
+        long long sum = 0;
+        vector<int> last(producers, -1);
+        bool ordered = true;
+        vector<typename Queue::guard_type> popped;
+        for (int received = 0; received < producers * perProducer; ) {
+            popped.clear();
+            size_t count = queue.try_pop(back_inserter(popped), 16);
+            if (!count) { this_thread::yield(); }
+            for (auto& guard : popped) {
+                guard.call([&](int value) {
+                    sum += value;
+                    ordered = ordered && value > last[value / perProducer];
+                    last[value / perProducer] = value;
+                });
+            }
+            received += static_cast<int>(count);
+        }
+        for (thread& t : threads) { t.join(); }
+
+        const long long total = static_cast<long long>(producers) * perProducer;
+        REQUIRE(total * (total - 1) / 2 == sum);
+        REQUIRE(ordered);
+        REQUIRE(!queue.try_pop());
+    }
+}
+
+TEST_CASE("Handing guards between threads through a guard queue") {
+    SECTION("A single producer queue") {
+        check_guard_queue<spsc_guard_queue<Pointee>>();
+        check_guard_queue_across_threads<spsc_guard_queue<int>>(1);
+    }
+    SECTION("A multiple producer queue") {
+        check_guard_queue<mpsc_guard_queue<Pointee>>();
+        check_guard_queue_across_threads<mpsc_guard_queue<int>>(1);
+        check_guard_queue_across_threads<mpsc_guard_queue<int>>(4);
+    }
+}
+
+TEST_CASE("Using a synchronized_guard") {
+    SECTION("A default constructed synchronized_guard") {
+        synchronized_guard<unique_ptr<Pointee>> guard;
+        bool called = false;
+
+        REQUIRE(!guard);
+        guard.call([&](Pointee&) { called = true; });
+        guard.call_shared([&](const Pointee&) { called = true; });
+        REQUIRE(!called);
+        REQUIRE(-1 == guard.call_or([](Pointee& p) { return p.identifier; }, -1));
+        REQUIRE(-1 == guard.call_shared_or([](const Pointee& p) { return p.identifier; }, -1));
+    }
+    SECTION("A synchronized_guard with a pointee") {
+        synchronized_guard<unique_ptr<Pointee>> guard(make_unique<Pointee>(1));
+        ptr_guard<Pointee*> other;
+
+        REQUIRE(guard);
+        guard.call([](Pointee& p) { p.identifier = 2; });
+        REQUIRE(2 == guard.call_shared_or([](const Pointee& p) { return p.identifier; }, -1));
+        REQUIRE(-1 == guard.call_or([](Pointee&, Pointee&) { return 0; }, -1, other));
+
+        guard.reset();
+        REQUIRE(!guard);
+    }
+    SECTION("Readers of a shared_mutex guard see whole writes") {
+        synchronized_guard<unique_ptr<SequencedPair>, shared_mutex> guard(make_unique<SequencedPair>());
+        atomic<bool> consistent(true);
+        vector<thread> threads;
+        threads.emplace_back([&] {
+            for (int i = 1; i <= 2000; ++i) { guard.call([i](SequencedPair& v) { v.first = i; v.second = i; }); }
+        });
+        for (int t = 0; t < 3; ++t) {
+            threads.emplace_back([&] {
+                for (int i = 0; i < 2000; ++i) {
+                    if (!guard.call_shared_or([](const SequencedPair& v) { return v.first == v.second; }, false)) { consistent = false; }
+                }
+            });
+        }
+        for (thread& t : threads) { t.join(); }
+
+        REQUIRE(consistent);
+        REQUIRE(2000 == guard.call_shared_or([](const SequencedPair& v) { return v.first; }, -1));
+    }
+    SECTION("A seq_lock guard passes readers a copy") {
+        SequencedPair value;
+        synchronized_guard<SequencedPair*, seq_lock> guard(&value);
+
+        guard.call([](SequencedPair& v) { v.first = 3; v.second = 4; });
+        REQUIRE(7 == guard.call_shared_or([](const SequencedPair& v) { return v.first + v.second; }, -1));
+        guard.call_shared([&](const SequencedPair& v) { REQUIRE(&v != &value); });
+
+        guard.reset();
+        REQUIRE(!guard);
+        REQUIRE(-1 == guard.call_shared_or([](const SequencedPair& v) { return v.first; }, -1));
+    }
+}
+
+namespace {
+    // A lock which fails once a given number of locks have been taken.
+    struct FailingLock {
+        static int locksBeforeFailure;
+        static int held;
+
+        void lock() {
+            if (!locksBeforeFailure--) { throw std::system_error(std::make_error_code(std::errc::resource_deadlock_would_occur)); }
+            ++held;
+        }
+        void unlock() noexcept { --held; }
+    };
+
+    int FailingLock::locksBeforeFailure = 0;
+    int FailingLock::held = 0;
+}
+
+TEST_CASE("Calling with several synchronized_guards") {
+    synchronized_guard<unique_ptr<Pointee>> a(make_unique<Pointee>(1));
+    synchronized_guard<unique_ptr<Pointee>, recursive_mutex> b(make_unique<Pointee>(2));
+    synchronized_guard<unique_ptr<Pointee>> empty;
+    int sum = 0;
+
+    call_synchronized([&](Pointee& x, Pointee& y) { sum = x.identifier + y.identifier; }, a, b);
+    REQUIRE(3 == sum);
+
+    SECTION("A guard passed twice is locked once") {
+        call_synchronized([&](Pointee& x, Pointee& y) { sum = x.identifier + y.identifier; }, a, a);
+        REQUIRE(2 == sum);
+    }
+    SECTION("A null guard skips the call") {
+        call_synchronized([&](Pointee&, Pointee&) { sum = 0; }, a, empty);
+        REQUIRE(3 == sum);
+    }
+    SECTION("Guards locked in opposite orders do not deadlock") {
+        thread forward([&] {
+            for (int i = 0; i < 2000; ++i) { call_synchronized([](Pointee& x, Pointee& y) { ++x.identifier; --y.identifier; }, a, b); }
+        });
+        thread backward([&] {
+            for (int i = 0; i < 2000; ++i) { call_synchronized([](Pointee& x, Pointee& y) { ++x.identifier; --y.identifier; }, b, a); }
+        });
+        forward.join();
+        backward.join();
+
+        call_synchronized([&](Pointee& x, Pointee& y) { sum = x.identifier + y.identifier; }, a, b);
+        REQUIRE(3 == sum);
+    }
+    SECTION("Locks already taken are released when locking throws") {
+        synchronized_guard<unique_ptr<Pointee>, FailingLock> c(make_unique<Pointee>(3));
+        synchronized_guard<unique_ptr<Pointee>, FailingLock> d(make_unique<Pointee>(4));
+        FailingLock::locksBeforeFailure = 1;
+        FailingLock::held = 0;
+
+        REQUIRE_THROWS_AS(call_synchronized([&](Pointee&, Pointee&) { sum = 0; }, c, d), std::system_error);
+        REQUIRE(0 == FailingLock::held);
+        REQUIRE(3 == sum);
+    }
+}
+
+#if __cplusplus > 201703L && defined(PTR_GUARD_REFCOUNT_AUDIT)
+TEST_CASE("Auditing the reference counting of guards") {
+    reset_refcount_audit();
+    ptr_guard<shared_ptr<DerivedFromPointee>> derived = make_guarded_shared<DerivedFromPointee>();
+    ptr_guard<weak_ptr<Pointee>> weak;
+    ptr_guard<Pointee*> raw = derived;
+
+    for (int i = 0; i < 3; ++i) { ptr_guard<shared_ptr<Pointee>> converted(derived); }
+    ptr_guard<shared_ptr<DerivedFromPointee>> copied(derived);
+    ptr_guard<shared_ptr<DerivedFromPointee>> moved(std::move(copied));
+    weak = derived;
+    std::thread([&] { weak.lock(); }).join();
+
+    vector<refcount_audit_site> report = refcount_audit_report();
+    auto sites_counting = [&](uint64_t refcount_audit_site::* counter) {
+        return std::count_if(report.begin(), report.end(), [&](refcount_audit_site const& site) { return site.*counter != 0; });
+    };
+
+    REQUIRE(!report.empty());
+    REQUIRE(3 == report.front().conversions);
+    REQUIRE(1 == sites_counting(&refcount_audit_site::copies));
+    REQUIRE(1 == sites_counting(&refcount_audit_site::moves));
+    REQUIRE(1 == sites_counting(&refcount_audit_site::locks));
+
+    reset_refcount_audit();
+    shared_ptr<DerivedFromPointee> owner = make_shared<DerivedFromPointee>();
+    ptr_guard<shared_ptr<DerivedFromPointee>> fromOwner = owner;
+    ptr_guard<shared_ptr<Pointee>> convertedOwner(owner);
+    ptr_guard<shared_ptr<DerivedFromPointee>> fromTemporary = make_shared<DerivedFromPointee>();
+    fromTemporary = owner;
+    report = refcount_audit_report();
+
+    REQUIRE(2 == sites_counting(&refcount_audit_site::copies));
+    REQUIRE(1 == sites_counting(&refcount_audit_site::conversions));
+    REQUIRE(0 == sites_counting(&refcount_audit_site::moves));
+}
+#endif
+
+#if __cplusplus > 201703L
+TEST_CASE("Using a ptr_guard of an array") {
+    static_assert(std::is_same<typename ptr_guard<array_ptr<unique_ptr<int[]>>>::element_type, const std::span<int>>::value, "Element type of array_ptr<unique_ptr<T[]>> is a span of T");
+
+    SECTION("A default constructed ptr_guard") {
+        ptr_guard<array_ptr<unique_ptr<int[]>>> guard;
+
+        REQUIRE(!guard);
+        REQUIRE(-1 == guard.call_or([](std::span<int> values) { return static_cast<int>(values.size()); }, -1));
+    }
+    SECTION("A guarded unique array is passed as a span") {
+        ptr_guard<array_ptr<unique_ptr<int[]>>> guard = make_guarded_unique<int[]>(100);
+
+        REQUIRE(guard);
+        guard.call([](std::span<int> values) {
+            for (size_t i = 0; i < values.size(); ++i) { values[i] = static_cast<int>(i); }
+        });
+        REQUIRE(4950 == guard.call_or([](std::span<const int> values) {
+            int sum = 0;
+            for (int v : values) { sum += v; }
+            return sum;
+        }, -1));
+
+        SECTION("Moving the guard leaves the source null.") {
+            ptr_guard<array_ptr<unique_ptr<int[]>>> moved(std::move(guard));
+
+            REQUIRE(!guard);
+            REQUIRE(moved);
+        }
+        SECTION("After reset of the pointer guard.") {
+            guard.reset();
+
+            REQUIRE(!guard);
+        }
+    }
+    SECTION("A guarded shared array destroys its elements once") {
+        TestContext context;
+        {
+            ptr_guard<array_ptr<shared_ptr<Pointee[]>>> guard = make_guarded_shared<Pointee[]>(3);
+            ptr_guard<array_ptr<shared_ptr<Pointee[]>>> copy = guard;
+
+            REQUIRE(3 == copy.call_or([](std::span<Pointee> values) { return values.size(); }, size_t(0)));
+        }
+        REQUIRE(3 == context.pointeeDestructorCalls);
+    }
+    SECTION("A guarded pointer and size pair") {
+        int values[] = { 1, 2, 3 };
+        ptr_guard<array_ptr<int*>> guard(array_ptr<int*>(values, 3));
+        ptr_guard<Pointee*> other;
+
+        REQUIRE(6 == guard.call_or([](std::span<int> v) { return v[0] + v[1] + v[2]; }, -1));
+        REQUIRE(-1 == guard.call_or([](std::span<int>, Pointee&) { return 0; }, -1, other));
+
+        guard.reset(nullptr, 3);
+        REQUIRE(!guard);
+    }
 }
 #endif
@@ -0,0 +1,277 @@
+/**
+ * An object cache handing out ptr_guard<shared_ptr<V>>. A bounded number of recently used values
+ * are held strongly and chosen for eviction by the CLOCK algorithm. Evicted values are only held
+ * weakly, so a value still in use elsewhere stays in the cache and a later lookup revives it
+ * without loading it again. The cache is split into shards, each with its own lock.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __GUARDED_CACHE_H__
+#define __GUARDED_CACHE_H__
+
+#include "ptr_guard.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace std {
+namespace experimental {
+    template <class K, class V, class Hash = hash<K>, class KeyEqual = equal_to<K>>
+    class guarded_cache {
+    public:
+        typedef K key_type;
+        typedef V mapped_type;
+        typedef ptr_guard<shared_ptr<V>> guard_type;
+
+        static constexpr size_t default_shards = 16;
+
+        // Capacity is the number of values held strongly, divided evenly between the shards.
+        explicit guarded_cache(size_t capacity, size_t shards = default_shards);
+
+        guarded_cache(guarded_cache const&) = delete;
+        guarded_cache& operator =(guarded_cache const&) = delete;
+
+        // A null guard when the key is not cached or its value has expired.
+        guard_type find(K const& key);
+
+        // Loads the value with load(key) when it is not cached. The load runs without holding
+        // the shard lock, and when two loads of one key race the value cached first is kept.
+        template <class Load>
+        guard_type find_or_load(K const& key, Load&& load);
+
+        guard_type insert(K const& key, shared_ptr<V> value);
+        bool erase(K const& key);
+        void clear();
+
+        size_t capacity() const noexcept { return _shards.size() * _shardCapacity; }
+
+        // The number of keys with a value still alive, held either strongly or elsewhere.
+        size_t size() const;
+
+    private:
+        struct entry {
+            shared_ptr<V> strong;
+            weak_ptr<V> weak;
+            size_t slot;
+            bool referenced;
+        };
+
+        typedef unordered_map<K, entry, Hash, KeyEqual> map_type;
+        typedef typename map_type::value_type node_type;
+
+        // The clock holds the entries which are strongly held. Map nodes never move, so the
+        // clock points at them directly.
+        struct shard {
+            mutable mutex lock;
+            map_type entries;
+            vector<node_type*> clock;
+            size_t hand = 0;
+            size_t sweep_at = 0;
+        };
+
+        static constexpr size_t npos = size_t(-1);
+
+        shard& shard_for(K const& key);
+        // The value evicted to make room is moved to evicted, so the caller drops the reference
+        // after unlocking the shard rather than destroying the value under its lock.
+        void hold_strongly(shard& s, node_type& node, shared_ptr<V>& evicted);
+        void release_slot(shard& s, entry& e) noexcept;
+        void sweep_expired(shard& s);
+
+        vector<unique_ptr<shard>> _shards;
+        size_t _shardCapacity;
+        Hash _hash;
+    };
+
+    template <class K, class V, class Hash, class KeyEqual>
+    guarded_cache<K, V, Hash, KeyEqual>::guarded_cache(size_t capacity, size_t shards)
+      : _shardCapacity(0), _hash() {
+        if (!shards) { shards = 1; }
+        if (shards > capacity && capacity) { shards = capacity; }
+        _shardCapacity = (capacity + shards - 1) / shards;
+        if (!_shardCapacity) { _shardCapacity = 1; }
+        for (size_t i = 0; i < shards; ++i) {
+            _shards.emplace_back(new shard());
+            _shards.back()->clock.assign(_shardCapacity, nullptr);
+            _shards.back()->sweep_at = 2 * _shardCapacity;
+        }
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    typename guarded_cache<K, V, Hash, KeyEqual>::guard_type guarded_cache<K, V, Hash, KeyEqual>::find(K const& key) {
+        shard& s = shard_for(key);
+        shared_ptr<V> evicted;
+        lock_guard<mutex> lock(s.lock);
+        auto it = s.entries.find(key);
+        if (it == s.entries.end()) { return guard_type(); }
+
+        entry& e = it->second;
+        if (e.strong) {
+            e.referenced = true;
+            return guard_type(e.strong);
+        }
+
+        // An evicted value which is still in use elsewhere is revived.
+        shared_ptr<V> value = e.weak.lock();
+        if (!value) {
+            s.entries.erase(it);
+            return guard_type();
+        }
+        e.strong = value;
+        hold_strongly(s, *it, evicted);
+        return guard_type(std::move(value));
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    template <class Load>
+    typename guarded_cache<K, V, Hash, KeyEqual>::guard_type guarded_cache<K, V, Hash, KeyEqual>::find_or_load(K const& key, Load&& load) {
+        guard_type found = find(key);
+        if (found) { return found; }
+
+        shared_ptr<V> loaded(load(key));
+        if (!loaded) { return guard_type(); }
+
+        shard& s = shard_for(key);
+        shared_ptr<V> evicted;
+        lock_guard<mutex> lock(s.lock);
+        auto result = s.entries.try_emplace(key, entry{ nullptr, {}, npos, false });
+        entry& e = result.first->second;
+        if (!result.second) {
+            if (e.strong) { return guard_type(e.strong); }
+            if (shared_ptr<V> raced = e.weak.lock()) {
+                e.strong = std::move(raced);
+                hold_strongly(s, *result.first, evicted);
+                return guard_type(e.strong);
+            }
+        }
+        e.strong = loaded;
+        e.weak = loaded;
+        hold_strongly(s, *result.first, evicted);
+        return guard_type(std::move(loaded));
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    typename guarded_cache<K, V, Hash, KeyEqual>::guard_type guarded_cache<K, V, Hash, KeyEqual>::insert(K const& key, shared_ptr<V> value) {
+        shard& s = shard_for(key);
+        shared_ptr<V> evicted;
+        lock_guard<mutex> lock(s.lock);
+        if (!value) {
+            auto it = s.entries.find(key);
+            if (it != s.entries.end()) {
+                release_slot(s, it->second);
+                evicted = std::move(it->second.strong);
+                s.entries.erase(it);
+            }
+            return guard_type();
+        }
+
+        auto result = s.entries.try_emplace(key, entry{ nullptr, {}, npos, false });
+        entry& e = result.first->second;
+        evicted = std::exchange(e.strong, value);
+        e.weak = value;
+        if (e.slot == npos) {
+            hold_strongly(s, *result.first, evicted);
+        } else {
+            e.referenced = true;
+        }
+        return guard_type(std::move(value));
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    bool guarded_cache<K, V, Hash, KeyEqual>::erase(K const& key) {
+        shard& s = shard_for(key);
+        shared_ptr<V> evicted;
+        lock_guard<mutex> lock(s.lock);
+        auto it = s.entries.find(key);
+        if (it == s.entries.end()) { return false; }
+        release_slot(s, it->second);
+        evicted = std::move(it->second.strong);
+        s.entries.erase(it);
+        return true;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    void guarded_cache<K, V, Hash, KeyEqual>::clear() {
+        for (unique_ptr<shard>& s : _shards) {
+            // The entries are destroyed once the shard is unlocked.
+            map_type entries;
+            lock_guard<mutex> lock(s->lock);
+            entries.swap(s->entries);
+            s->clock.assign(_shardCapacity, nullptr);
+            s->hand = 0;
+        }
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    size_t guarded_cache<K, V, Hash, KeyEqual>::size() const {
+        size_t count = 0;
+        for (unique_ptr<shard> const& s : _shards) {
+            lock_guard<mutex> lock(s->lock);
+            for (node_type const& node : s->entries) {
+                if (!node.second.weak.expired()) { ++count; }
+            }
+        }
+        return count;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    typename guarded_cache<K, V, Hash, KeyEqual>::shard& guarded_cache<K, V, Hash, KeyEqual>::shard_for(K const& key) {
+        // The shard comes from the high bits, the map buckets use the low bits.
+        uint64_t h = static_cast<uint64_t>(_hash(key)) * 0x9E3779B97F4A7C15ull;
+        return *_shards[static_cast<size_t>(h >> 32) % _shards.size()];
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    void guarded_cache<K, V, Hash, KeyEqual>::hold_strongly(shard& s, node_type& node, shared_ptr<V>& evicted) {
+        // Advance the hand, giving referenced entries a second chance, to a free slot or to the
+        // entry to evict. Every entry passed is unreferenced, so this ends within two turns.
+        for (;;) {
+            node_type*& slot = s.clock[s.hand];
+            if (!slot) { break; }
+            entry& victim = slot->second;
+            if (!victim.referenced) {
+                evicted = std::move(victim.strong);
+                victim.slot = npos;
+                break;
+            }
+            victim.referenced = false;
+            s.hand = (s.hand + 1) % s.clock.size();
+        }
+
+        s.clock[s.hand] = &node;
+        node.second.slot = s.hand;
+        node.second.referenced = false;
+        s.hand = (s.hand + 1) % s.clock.size();
+
+        if (s.entries.size() >= s.sweep_at) { sweep_expired(s); }
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    void guarded_cache<K, V, Hash, KeyEqual>::release_slot(shard& s, entry& e) noexcept {
+        if (e.slot != npos) { s.clock[e.slot] = nullptr; }
+        e.slot = npos;
+    }
+
+    template <class K, class V, class Hash, class KeyEqual>
+    void guarded_cache<K, V, Hash, KeyEqual>::sweep_expired(shard& s) {
+        // Weakly held entries are dropped in bulk once they have expired. The next sweep is
+        // put off until the map has doubled again, so sweeping is amortized over insertions.
+        for (auto it = s.entries.begin(); it != s.entries.end(); ) {
+            if (it->second.slot == npos && it->second.weak.expired()) {
+                it = s.entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        s.sweep_at = 2 * (s.entries.size() > _shardCapacity ? s.entries.size() : _shardCapacity);
+    }
+}
+}
+
+#endif // __GUARDED_CACHE_H__
@@ -0,0 +1,307 @@
+/**
+ * Null safe callbacks. A guarded_function stores its callable inline, never allocating, and like
+ * a ptr_guard it is invoked only through call() and call_or(), so an empty callback is skipped or
+ * yields a default rather than throwing bad_function_call. A guarded_function_ref is the non
+ * owning equivalent for passing a callback down a call chain.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __GUARDED_FUNCTION_H__
+#define __GUARDED_FUNCTION_H__
+
+#include "ptr_guard.h"
+
+#include <cstddef>
+#include <new>
+
+namespace std {
+namespace experimental {
+    namespace __detail {
+        // Function pointers may not convert to void*, so a callable is addressed by this union.
+        union callable_target {
+            void* object;
+            void (*function)();
+        };
+
+        template <class R, class... Args>
+        struct function_vtable {
+            R (*invoke)(callable_target f, Args&&... args);
+            void (*copy)(void* to, const void* from);
+            void (*move)(void* to, void* from) noexcept;
+            void (*destroy)(void* f) noexcept;
+        };
+
+        template <class F, class R, class... Args>
+        struct function_vtable_for {
+            static R invoke(callable_target f, Args&&... args) {
+                return static_cast<R>(std::invoke(*static_cast<F*>(f.object), std::forward<Args>(args)...));
+            }
+
+            static void copy(void* to, const void* from) {
+                ::new (to) F(*static_cast<const F*>(from));
+            }
+
+            // Moves the callable to the new storage and destroys what is left in the old.
+            static void move(void* to, void* from) noexcept {
+                ::new (to) F(std::move(*static_cast<F*>(from)));
+                static_cast<F*>(from)->~F();
+            }
+
+            static void destroy(void* f) noexcept {
+                static_cast<F*>(f)->~F();
+            }
+
+            static constexpr function_vtable<R, Args...> table = { &invoke, &copy, &move, &destroy };
+        };
+
+        template <class F, class R, class... Args>
+        constexpr function_vtable<R, Args...> function_vtable_for<F, R, Args...>::table;
+
+        // Null function and member pointers make empty callbacks, as they do a std::function.
+        template <class F>
+        bool is_null_callable(F const& f) noexcept {
+            if constexpr (is_pointer<F>::value || is_member_pointer<F>::value) {
+                return f == nullptr;
+            } else {
+                return false;
+            }
+        }
+
+        template <class Signature>
+        struct is_guarded_function_signature : false_type { };
+
+        template <class R, class... Args>
+        struct is_guarded_function_signature<R(Args...)> : true_type { };
+    }
+
+    template <class Signature, size_t Size = 4 * sizeof(void*)>
+    class guarded_function {
+        static_assert(__detail::is_guarded_function_signature<Signature>::value, "guarded_function takes a function signature R(Args...).");
+    };
+
+    template <class Signature>
+    class guarded_function_ref {
+        static_assert(__detail::is_guarded_function_signature<Signature>::value, "guarded_function_ref takes a function signature R(Args...).");
+    };
+
+    // The callable must fit in Size bytes with at most max_align_t alignment, be copyable, and be
+    // nothrow movable. These are checked at compile time so storing a callable never allocates.
+    template <class R, class... Args, size_t Size>
+    class guarded_function<R(Args...), Size> {
+    public:
+        typedef R result_type;
+
+        static constexpr size_t capacity = Size;
+
+    private:
+        template <class F>
+        using enable_if_callable = typename enable_if<
+            !is_same<typename decay<F>::type, guarded_function>::value &&
+            is_invocable_r<R, typename decay<F>::type&, Args...>::value>::type;
+
+    public:
+        guarded_function() noexcept = default;
+        guarded_function(nullptr_t) noexcept { }
+        template <class F, class = enable_if_callable<F>>
+        guarded_function(F&& f) noexcept(is_nothrow_constructible<typename decay<F>::type, F&&>::value);
+        guarded_function(guarded_function const& other);
+        guarded_function(guarded_function&& other) noexcept;
+        ~guarded_function();
+
+        guarded_function& operator =(guarded_function const& other);
+        guarded_function& operator =(guarded_function&& other) noexcept;
+        guarded_function& operator =(nullptr_t) noexcept;
+        template <class F, class = enable_if_callable<F>>
+        guarded_function& operator =(F&& f);
+
+        explicit operator bool() const noexcept { return _vtable != nullptr; }
+
+        void reset() noexcept;
+        void swap(guarded_function& other) noexcept;
+
+        // Invokes the callable, or does nothing when empty.
+        void call(Args... args) const;
+
+        // Invokes the callable returning its result, or returns def when empty.
+        template <class Ret>
+        R call_or(Ret&& def, Args... args) const;
+
+    private:
+        template <class Signature>
+        friend class guarded_function_ref;
+
+        alignas(max_align_t) mutable unsigned char _storage[Size];
+        const __detail::function_vtable<R, Args...>* _vtable = nullptr;
+    };
+
+    // A guarded_function_ref refers to a callable owned elsewhere and must not outlive it. It is
+    // trivially copyable and two words in size.
+    template <class R, class... Args>
+    class guarded_function_ref<R(Args...)> {
+    private:
+        template <class F>
+        using enable_if_callable = typename enable_if<
+            !is_same<typename decay<F>::type, guarded_function_ref>::value &&
+            is_invocable_r<R, F&, Args...>::value>::type;
+
+    public:
+        constexpr guarded_function_ref() noexcept = default;
+        constexpr guarded_function_ref(nullptr_t) noexcept { }
+        template <class F, class = enable_if_callable<F>>
+        guarded_function_ref(F&& f) noexcept;
+        template <size_t Size>
+        guarded_function_ref(guarded_function<R(Args...), Size> const& f) noexcept;
+
+        explicit operator bool() const noexcept { return _invoke != nullptr; }
+
+        void call(Args... args) const;
+
+        template <class Ret>
+        R call_or(Ret&& def, Args... args) const;
+
+    private:
+        __detail::callable_target _target = { nullptr };
+        R (*_invoke)(__detail::callable_target, Args&&...) = nullptr;
+    };
+
+    template <class R, class... Args, size_t Size>
+    template <class F, class>
+    guarded_function<R(Args...), Size>::guarded_function(F&& f) noexcept(is_nothrow_constructible<typename decay<F>::type, F&&>::value) {
+        typedef typename decay<F>::type Fn;
+        static_assert(sizeof(Fn) <= Size, "The callable does not fit in the guarded_function, increase its Size.");
+        static_assert(alignof(Fn) <= alignof(max_align_t), "The callable is over aligned for a guarded_function.");
+        static_assert(is_copy_constructible<Fn>::value, "A guarded_function callable must be copyable.");
+        static_assert(is_nothrow_move_constructible<Fn>::value, "A guarded_function callable must be nothrow movable.");
+
+        if (__detail::is_null_callable(f)) { return; }
+        ::new (static_cast<void*>(_storage)) Fn(std::forward<F>(f));
+        _vtable = &__detail::function_vtable_for<Fn, R, Args...>::table;
+    }
+
+    template <class R, class... Args, size_t Size>
+    guarded_function<R(Args...), Size>::guarded_function(guarded_function const& other) {
+        if (!other._vtable) { return; }
+        other._vtable->copy(_storage, other._storage);
+        _vtable = other._vtable;
+    }
+
+    template <class R, class... Args, size_t Size>
+    guarded_function<R(Args...), Size>::guarded_function(guarded_function&& other) noexcept {
+        if (!other._vtable) { return; }
+        other._vtable->move(_storage, other._storage);
+        _vtable = other._vtable;
+        other._vtable = nullptr;
+    }
+
+    template <class R, class... Args, size_t Size>
+    guarded_function<R(Args...), Size>::~guarded_function() {
+        reset();
+    }
+
+    template <class R, class... Args, size_t Size>
+    guarded_function<R(Args...), Size>& guarded_function<R(Args...), Size>::operator =(guarded_function const& other) {
+        if (this != &other) {
+            guarded_function copy(other);
+            reset();
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    template <class R, class... Args, size_t Size>
+    guarded_function<R(Args...), Size>& guarded_function<R(Args...), Size>::operator =(guarded_function&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other._vtable) {
+                other._vtable->move(_storage, other._storage);
+                _vtable = other._vtable;
+                other._vtable = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    template <class R, class... Args, size_t Size>
+    guarded_function<R(Args...), Size>& guarded_function<R(Args...), Size>::operator =(nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    template <class R, class... Args, size_t Size>
+    template <class F, class>
+    guarded_function<R(Args...), Size>& guarded_function<R(Args...), Size>::operator =(F&& f) {
+        return *this = guarded_function(std::forward<F>(f));
+    }
+
+    template <class R, class... Args, size_t Size>
+    void guarded_function<R(Args...), Size>::reset() noexcept {
+        if (!_vtable) { return; }
+        _vtable->destroy(_storage);
+        _vtable = nullptr;
+    }
+
+    template <class R, class... Args, size_t Size>
+    void guarded_function<R(Args...), Size>::swap(guarded_function& other) noexcept {
+        guarded_function temp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(temp);
+    }
+
+    template <class R, class... Args, size_t Size>
+    void guarded_function<R(Args...), Size>::call(Args... args) const {
+        if (_vtable) { _vtable->invoke(__detail::callable_target{ _storage }, std::forward<Args>(args)...); }
+    }
+
+    template <class R, class... Args, size_t Size>
+    template <class Ret>
+    R guarded_function<R(Args...), Size>::call_or(Ret&& def, Args... args) const {
+        static_assert(!is_void<R>::value, "call_or needs a result to default, use call for void callbacks.");
+        if (!_vtable) { return static_cast<R>(std::forward<Ret>(def)); }
+        return _vtable->invoke(__detail::callable_target{ _storage }, std::forward<Args>(args)...);
+    }
+
+    template <class R, class... Args>
+    template <class F, class>
+    guarded_function_ref<R(Args...)>::guarded_function_ref(F&& f) noexcept {
+        typedef typename remove_reference<F>::type Fn;
+        if (__detail::is_null_callable(f)) { return; }
+        if constexpr (is_function<typename remove_pointer<Fn>::type>::value) {
+            _target.function = reinterpret_cast<void (*)()>(static_cast<typename decay<F>::type>(f));
+            _invoke = [](__detail::callable_target t, Args&&... args) -> R {
+                return static_cast<R>(std::invoke(reinterpret_cast<typename decay<F>::type>(t.function), std::forward<Args>(args)...));
+            };
+        } else {
+            _target.object = const_cast<void*>(static_cast<const volatile void*>(std::addressof(f)));
+            _invoke = [](__detail::callable_target t, Args&&... args) -> R {
+                return static_cast<R>(std::invoke(*static_cast<Fn*>(t.object), std::forward<Args>(args)...));
+            };
+        }
+    }
+
+    template <class R, class... Args>
+    template <size_t Size>
+    guarded_function_ref<R(Args...)>::guarded_function_ref(guarded_function<R(Args...), Size> const& f) noexcept {
+        // Refer straight to the callable the guarded_function holds, skipping its vtable.
+        if (!f._vtable) { return; }
+        _target.object = f._storage;
+        _invoke = f._vtable->invoke;
+    }
+
+    template <class R, class... Args>
+    void guarded_function_ref<R(Args...)>::call(Args... args) const {
+        if (_invoke) { _invoke(_target, std::forward<Args>(args)...); }
+    }
+
+    template <class R, class... Args>
+    template <class Ret>
+    R guarded_function_ref<R(Args...)>::call_or(Ret&& def, Args... args) const {
+        static_assert(!is_void<R>::value, "call_or needs a result to default, use call for void callbacks.");
+        if (!_invoke) { return static_cast<R>(std::forward<Ret>(def)); }
+        return _invoke(_target, std::forward<Args>(args)...);
+    }
+}
+}
+
+#endif // __GUARDED_FUNCTION_H__
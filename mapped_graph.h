@@ -0,0 +1,223 @@
+/**
+ * Persistence of read only object graphs linked by ptr_guard<offset_ptr<T>> members. The writer
+ * lays the graph out in a single buffer which is written to a file, and the reader maps that file
+ * and hands out guards to the objects in place, so loading the graph needs no deserialization.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __MAPPED_GRAPH_H__
+#define __MAPPED_GRAPH_H__
+
+#include "ptr_guard.h"
+#include "offset_ptr.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace std {
+namespace experimental {
+    namespace __detail {
+        struct mapped_graph_header {
+            uint64_t magic;
+            uint64_t size;
+            uint64_t root;
+        };
+
+        constexpr uint64_t mapped_graph_magic = 0x5054524752415048ull;
+    }
+
+    // Whether an object keeps its meaning when written out as bytes and mapped back at another
+    // address. Trivially copyable types do. Types linked by offset_ptr members are not trivially
+    // copyable, as copying an offset_ptr adjusts its offset, but may be declared mappable by
+    // specializing this trait once they hold no raw pointers.
+    template <class T>
+    struct is_mappable : is_trivially_copyable<T> { };
+
+    // Objects are constructed in a buffer of fixed capacity so they never move while the graph
+    // is being linked together. The objects are written out as bytes and never destroyed, so
+    // they must be trivially destructible, must be mappable and not polymorphic, and should refer
+    // to each other only by offset_ptr. The buffer is zeroed, so padding is written as zeros.
+    class mapped_graph_writer {
+    public:
+        explicit mapped_graph_writer(size_t capacity);
+        ~mapped_graph_writer();
+
+        mapped_graph_writer(mapped_graph_writer const&) = delete;
+        mapped_graph_writer& operator =(mapped_graph_writer const&) = delete;
+
+        template <class T, class... Args>
+        T* construct(Args&&... args);
+
+        template <class T>
+        void set_root(T const* root) noexcept;
+
+        size_t size() const noexcept { return _size; }
+        size_t capacity() const noexcept { return _capacity; }
+
+        void write(const char* path) const;
+
+    private:
+        char* _data;
+        size_t _size;
+        size_t _capacity;
+    };
+
+    class mapped_graph {
+    public:
+        explicit mapped_graph(const char* path);
+        mapped_graph(mapped_graph&& other) noexcept;
+        ~mapped_graph();
+
+        mapped_graph(mapped_graph const&) = delete;
+        mapped_graph& operator =(mapped_graph const&) = delete;
+
+        template <class T>
+        ptr_guard<const T*> root() const noexcept;
+
+        size_t size() const noexcept { return _size; }
+
+    private:
+        void unmap() noexcept;
+
+        const char* _data = nullptr;
+        size_t _size = 0;
+    };
+
+    inline mapped_graph_writer::mapped_graph_writer(size_t capacity)
+      : _data(static_cast<char*>(::operator new(capacity + sizeof(__detail::mapped_graph_header)))),
+        _size(sizeof(__detail::mapped_graph_header)),
+        _capacity(capacity + sizeof(__detail::mapped_graph_header)) {
+        memset(_data, 0, _capacity);
+    }
+
+    inline mapped_graph_writer::~mapped_graph_writer() {
+        ::operator delete(_data);
+    }
+
+    template <class T, class... Args>
+    T* mapped_graph_writer::construct(Args&&... args) {
+        static_assert(is_trivially_destructible<T>::value, "Objects in a mapped graph are never destroyed.");
+        static_assert(is_mappable<T>::value && !is_polymorphic<T>::value,
+                      "Objects in a mapped graph must be mappable as bytes, and a virtual table pointer is not.");
+        static_assert(alignof(T) <= alignof(max_align_t), "Objects in a mapped graph are at most max_align_t aligned.");
+
+        size_t offset = (_size + alignof(T) - 1) & ~(alignof(T) - 1);
+        if (offset + sizeof(T) > _capacity) { throw bad_alloc(); }
+        _size = offset + sizeof(T);
+        return ::new (static_cast<void*>(_data + offset)) T(std::forward<Args>(args)...);
+    }
+
+    template <class T>
+    void mapped_graph_writer::set_root(T const* root) noexcept {
+        __detail::mapped_graph_header* header = reinterpret_cast<__detail::mapped_graph_header*>(_data);
+        header->root = root ? static_cast<uint64_t>(reinterpret_cast<const char*>(root) - _data) : 0;
+    }
+
+    inline void mapped_graph_writer::write(const char* path) const {
+        // The header is completed in a copy, so writing leaves the buffer unchanged.
+        __detail::mapped_graph_header header;
+        memcpy(&header, _data, sizeof(header));
+        header.magic = __detail::mapped_graph_magic;
+        header.size = _size;
+
+        ofstream out;
+        out.exceptions(ios_base::failbit | ios_base::badbit);
+        out.open(path, ios_base::binary | ios_base::trunc);
+        out.write(reinterpret_cast<const char*>(&header), static_cast<streamsize>(sizeof(header)));
+        out.write(_data + sizeof(header), static_cast<streamsize>(_size - sizeof(header)));
+    }
+
+    inline mapped_graph::mapped_graph(const char* path) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) { throw system_error(static_cast<int>(GetLastError()), system_category(), path); }
+        LARGE_INTEGER size;
+        HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart
+            ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr)
+            : nullptr;
+        DWORD error = GetLastError();
+        CloseHandle(file);
+        if (!mapping) { throw system_error(static_cast<int>(error), system_category(), path); }
+        _data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        error = GetLastError();
+        CloseHandle(mapping);
+        if (!_data) { throw system_error(static_cast<int>(error), system_category(), path); }
+        _size = static_cast<size_t>(size.QuadPart);
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) { throw system_error(errno, generic_category(), path); }
+        struct stat status;
+        if (::fstat(fd, &status) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw system_error(error, generic_category(), path);
+        }
+        _size = static_cast<size_t>(status.st_size);
+        void* data = _size ? ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        int error = _size ? errno : EINVAL;
+        ::close(fd);
+        if (data == MAP_FAILED) { throw system_error(error, generic_category(), path); }
+        _data = static_cast<const char*>(data);
+#endif
+
+        const __detail::mapped_graph_header* header = reinterpret_cast<const __detail::mapped_graph_header*>(_data);
+        if (_size < sizeof(__detail::mapped_graph_header) || header->magic != __detail::mapped_graph_magic ||
+                header->size != _size || header->root >= _size) {
+            unmap();
+            throw system_error(make_error_code(errc::invalid_argument), path);
+        }
+    }
+
+    inline mapped_graph::mapped_graph(mapped_graph&& other) noexcept
+      : _data(other._data), _size(other._size) {
+        other._data = nullptr;
+        other._size = 0;
+    }
+
+    inline mapped_graph::~mapped_graph() {
+        unmap();
+    }
+
+    template <class T>
+    ptr_guard<const T*> mapped_graph::root() const noexcept {
+        const __detail::mapped_graph_header* header = reinterpret_cast<const __detail::mapped_graph_header*>(_data);
+        if (!header || !header->root) { return ptr_guard<const T*>(); }
+        // A truncated or corrupt file may place the root past the end of the mapping, or where
+        // no T could be. The mapping itself is page aligned, so the offset decides alignment.
+        const uint64_t root = header->root;
+        if (root > _size || _size - root < sizeof(T) || root % alignof(T) != 0) { return ptr_guard<const T*>(); }
+        return reinterpret_cast<const T*>(_data + root);
+    }
+
+    inline void mapped_graph::unmap() noexcept {
+        if (!_data) { return; }
+#ifdef _WIN32
+        UnmapViewOfFile(_data);
+#else
+        ::munmap(const_cast<char*>(_data), _size);
+#endif
+        _data = nullptr;
+        _size = 0;
+    }
+}
+}
+
+#endif // __MAPPED_GRAPH_H__
@@ -0,0 +1,138 @@
+/**
+ * A list of listeners held by non owning guards, by default ptr_guard<weak_ptr<T>>. Dispatch
+ * calls each listener which is still alive through the guard and removes expired listeners from
+ * the list as it goes, so expired entries are neither kept nor checked again by later dispatches.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __OBSERVER_LIST_H__
+#define __OBSERVER_LIST_H__
+
+#include "ptr_guard.h"
+
+#include <vector>
+
+namespace std {
+namespace experimental {
+    namespace __detail {
+        // Guards of weak pointers are locked for the duration of the call to their listener.
+        template <class G>
+        auto lock_observer(G const& guard, int) -> decltype(guard.lock()) { return guard.lock(); }
+
+        template <class G>
+        G const& lock_observer(G const& guard, long) { return guard; }
+    }
+
+    // Listeners may be added and removed by the listeners themselves during a dispatch, and may
+    // dispatch again. A listener added during a dispatch is first called by the next dispatch,
+    // and one removed during a dispatch is not called again by it. The list is not synchronized
+    // and must only be used from one thread at a time.
+    template <class T, class Pointer = weak_ptr<T>>
+    class observer_list {
+    public:
+        typedef ptr_guard<Pointer> guard_type;
+
+        observer_list() = default;
+        observer_list(observer_list const&) = delete;
+        observer_list& operator =(observer_list const&) = delete;
+
+        void add(guard_type listener);
+        bool remove(guard_type const& listener) noexcept;
+        void clear() noexcept;
+
+        // The number of listeners, including any which have expired since the last dispatch.
+        size_t size() const noexcept { return _entries.size() + _added.size(); }
+        bool empty() const noexcept { return size() == 0; }
+
+        // Calls func with each live listener followed by args, returning the number called.
+        template <class Func, class... Args>
+        size_t dispatch(Func&& func, Args&&... args);
+
+    private:
+        struct dispatch_scope;
+
+        vector<guard_type> _entries;
+        vector<guard_type> _added;
+        size_t _depth = 0;
+    };
+
+    // Leaving the outermost dispatch appends the listeners added during it. It is done by a
+    // destructor so a listener throwing from the dispatch leaves the list consistent.
+    template <class T, class Pointer>
+    struct observer_list<T, Pointer>::dispatch_scope {
+        explicit dispatch_scope(observer_list& list) noexcept : _list(list) { ++_list._depth; }
+
+        ~dispatch_scope() {
+            if (--_list._depth || _list._added.empty()) { return; }
+            _list._entries.insert(_list._entries.end(),
+                                  make_move_iterator(_list._added.begin()),
+                                  make_move_iterator(_list._added.end()));
+            _list._added.clear();
+        }
+
+        observer_list& _list;
+    };
+
+    template <class T, class Pointer>
+    void observer_list<T, Pointer>::add(guard_type listener) {
+        // The entries are not reallocated under a dispatch iterating over them.
+        (_depth ? _added : _entries).push_back(std::move(listener));
+    }
+
+    template <class T, class Pointer>
+    bool observer_list<T, Pointer>::remove(guard_type const& listener) noexcept {
+        // Removed entries are only reset, they are compacted along with expired entries.
+        for (vector<guard_type>* entries : { &_entries, &_added }) {
+            for (guard_type& entry : *entries) {
+                if (entry && entry == listener) {
+                    entry.reset();
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    template <class T, class Pointer>
+    void observer_list<T, Pointer>::clear() noexcept {
+        for (guard_type& entry : _entries) { entry.reset(); }
+        _added.clear();
+        if (!_depth) { _entries.clear(); }
+    }
+
+    template <class T, class Pointer>
+    template <class Func, class... Args>
+    size_t observer_list<T, Pointer>::dispatch(Func&& func, Args&&... args) {
+        dispatch_scope scope(*this);
+        const bool compact = _depth == 1;
+        const size_t count = _entries.size();
+        size_t called = 0;
+        size_t kept = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            bool alive = __detail::lock_observer(_entries[i], 0).call_or(
+                [&](auto& listener) {
+                    std::invoke(func, listener, args...);
+                    return true;
+                }, false);
+            if (alive) { ++called; }
+
+            // The outermost dispatch slides live entries down over expired ones. A nested
+            // dispatch sees each live listener once, either before or after its move.
+            if (!compact || !_entries[i]) { continue; }
+            if (kept != i) {
+                _entries[kept] = std::move(_entries[i]);
+                _entries[i].reset();
+            }
+            ++kept;
+        }
+
+        if (compact) { _entries.erase(_entries.begin() + kept, _entries.begin() + count); }
+        return called;
+    }
+}
+}
+
+#endif // __OBSERVER_LIST_H__
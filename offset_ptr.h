@@ -0,0 +1,113 @@
+/**
+ * A self relative pointer. The offset_ptr stores the distance from itself to the pointee so an
+ * object graph linked by offset_ptrs remains valid wherever the memory holding it is mapped. The
+ * pointer satisfies pointer_traits so ptr_guard<offset_ptr<T>> guards it like any other pointer.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __OFFSET_PTR_H__
+#define __OFFSET_PTR_H__
+
+#include "ptr_guard.h"
+
+namespace std {
+namespace experimental {
+    // A zero offset is the null pointer, so zero filled memory holds null pointers. This means
+    // an offset_ptr cannot point at the object it is itself the first member of.
+    template <class T>
+    class offset_ptr {
+    public:
+        typedef T element_type;
+        typedef ptrdiff_t difference_type;
+
+        template <class U>
+        using rebind = offset_ptr<U>;
+
+    public:
+        constexpr offset_ptr() noexcept = default;
+        constexpr offset_ptr(nullptr_t) noexcept { }
+        offset_ptr(T* p) noexcept { set(p); }
+        offset_ptr(offset_ptr const& other) noexcept { set(other.get()); }
+        template <class U, class = typename enable_if<is_convertible<U*, T*>::value>::type>
+        offset_ptr(offset_ptr<U> const& other) noexcept { set(other.get()); }
+
+        offset_ptr& operator =(offset_ptr const& other) noexcept;
+        offset_ptr& operator =(T* p) noexcept;
+        offset_ptr& operator =(nullptr_t) noexcept;
+
+        T* get() const noexcept;
+        T& operator *() const noexcept { return *get(); }
+        T* operator ->() const noexcept { return get(); }
+        explicit operator bool() const noexcept { return _offset != 0; }
+
+        void reset(T* p = nullptr) noexcept { set(p); }
+        void swap(offset_ptr& other) noexcept;
+
+        static offset_ptr pointer_to(T& r) noexcept { return offset_ptr(std::addressof(r)); }
+
+    private:
+        void set(T* p) noexcept;
+
+        intptr_t _offset = 0;
+    };
+
+    template <class T>
+    offset_ptr<T>& offset_ptr<T>::operator =(offset_ptr const& other) noexcept {
+        set(other.get());
+        return *this;
+    }
+
+    template <class T>
+    offset_ptr<T>& offset_ptr<T>::operator =(T* p) noexcept {
+        set(p);
+        return *this;
+    }
+
+    template <class T>
+    offset_ptr<T>& offset_ptr<T>::operator =(nullptr_t) noexcept {
+        _offset = 0;
+        return *this;
+    }
+
+    template <class T>
+    T* offset_ptr<T>::get() const noexcept {
+        return _offset ? reinterpret_cast<T*>(reinterpret_cast<intptr_t>(this) + _offset) : nullptr;
+    }
+
+    template <class T>
+    void offset_ptr<T>::swap(offset_ptr& other) noexcept {
+        T* p = get();
+        set(other.get());
+        other.set(p);
+    }
+
+    template <class T>
+    void offset_ptr<T>::set(T* p) noexcept {
+        _offset = p ? reinterpret_cast<intptr_t>(p) - reinterpret_cast<intptr_t>(this) : 0;
+    }
+
+    template <class T1, class T2>
+    bool operator ==(offset_ptr<T1> const& a, offset_ptr<T2> const& b) noexcept { return a.get() == b.get(); }
+
+    template <class T1, class T2>
+    bool operator !=(offset_ptr<T1> const& a, offset_ptr<T2> const& b) noexcept { return a.get() != b.get(); }
+
+    template <class T>
+    bool operator ==(offset_ptr<T> const& a, nullptr_t) noexcept { return !a; }
+
+    template <class T>
+    bool operator !=(offset_ptr<T> const& a, nullptr_t) noexcept { return static_cast<bool>(a); }
+
+    template <class T1, class T2>
+    bool operator <(offset_ptr<T1> const& a, offset_ptr<T2> const& b) noexcept { return less<>()(a.get(), b.get()); }
+}
+
+    template <class T>
+    struct hash<experimental::offset_ptr<T>> {
+        size_t operator ()(experimental::offset_ptr<T> const& p) const noexcept { return hash<T*>()(p.get()); }
+    };
+}
+
+#endif // __OFFSET_PTR_H__
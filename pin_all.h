@@ -0,0 +1,118 @@
+/**
+ * Pinning of a range of guards of weak pointers for batch processing. pin_all locks each guard
+ * once and keeps the shared pointers of the live pointees contiguously in a pinned_snapshot.
+ * Iterating the snapshot neither locks nor tests the pointers again, so a batch making several
+ * passes over a range pays for the reference counts once rather than on every pass, and the
+ * pointees are all released together when the snapshot is.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __PIN_ALL_H__
+#define __PIN_ALL_H__
+
+#include "ptr_guard.h"
+
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace std {
+namespace experimental {
+    // The pointees of a snapshot stay alive until it is released, assigned or destroyed. Copying
+    // a snapshot would take a reference to every pointee again, so snapshots are only moved.
+    template <class T>
+    class pinned_snapshot {
+    public:
+        typedef T element_type;
+
+        pinned_snapshot() = default;
+
+        template <class InputIt>
+        pinned_snapshot(InputIt first, InputIt last) { assign(first, last); }
+
+        pinned_snapshot(pinned_snapshot&&) = default;
+        pinned_snapshot& operator =(pinned_snapshot&&) = default;
+
+        pinned_snapshot(pinned_snapshot const&) = delete;
+        pinned_snapshot& operator =(pinned_snapshot const&) = delete;
+
+        // Releases the pinned pointees and pins those of the guards in [first, last) which have
+        // not expired, in the order of the range. The storage is reused, so a snapshot kept
+        // between batches does not allocate once it has grown to the size of the range.
+        template <class InputIt>
+        void assign(InputIt first, InputIt last);
+
+        // Releases every pinned pointee, keeping the storage.
+        void release() noexcept { _pinned.clear(); }
+
+        size_t size() const noexcept { return _pinned.size(); }
+        bool empty() const noexcept { return _pinned.empty(); }
+
+        // The number of guards of the last range pinned which had expired.
+        size_t expired() const noexcept { return _expired; }
+
+        // Calls func with each pinned pointee, followed by a dereference of each guard in args.
+        // The guards in args are tested once, and nothing is called when any of them is null.
+        // Returns the number of calls.
+        template <class Func, class... Args>
+        size_t call(Func&& func, Args&&... args) const;
+
+    private:
+        vector<shared_ptr<T>> _pinned;
+        size_t _expired = 0;
+    };
+
+    // Pins the live pointees of a range of ptr_guard<weak_ptr<T>>:
+    //
+    //     pinned_snapshot<Node> nodes = pin_all(graph.begin(), graph.end());
+    //     nodes.call([](Node& node) { node.visit(); });
+    //     nodes.call([](Node& node, Stats& stats) { stats.add(node); }, statsGuard);
+    template <class InputIt>
+    auto pin_all(InputIt first, InputIt last) -> pinned_snapshot<typename iterator_traits<InputIt>::value_type::element_type>;
+
+    template <class Range>
+    auto pin_all(Range const& range) -> decltype(pin_all(std::begin(range), std::end(range)));
+
+    template <class T>
+    template <class InputIt>
+    void pinned_snapshot<T>::assign(InputIt first, InputIt last) {
+        _pinned.clear();
+        _expired = 0;
+        if constexpr (is_base_of<forward_iterator_tag, typename iterator_traits<InputIt>::iterator_category>::value) {
+            _pinned.reserve(static_cast<size_t>(std::distance(first, last)));
+        }
+        for (; first != last; ++first) {
+            auto locked = (*first).lock();
+            if (locked) {
+                _pinned.push_back(__detail::access_guarded_pointer(std::move(locked)));
+            } else {
+                ++_expired;
+            }
+        }
+    }
+
+    template <class T>
+    template <class Func, class... Args>
+    size_t pinned_snapshot<T>::call(Func&& func, Args&&... args) const {
+        if (!__detail::all_args_are_safe_to_dereference(args...)) { return 0; }
+        for (shared_ptr<T> const& pinned : _pinned) {
+            std::invoke(func, *pinned, __detail::dereference_arg(args)...);
+        }
+        return _pinned.size();
+    }
+
+    template <class InputIt>
+    auto pin_all(InputIt first, InputIt last) -> pinned_snapshot<typename iterator_traits<InputIt>::value_type::element_type> {
+        return pinned_snapshot<typename iterator_traits<InputIt>::value_type::element_type>(first, last);
+    }
+
+    template <class Range>
+    auto pin_all(Range const& range) -> decltype(pin_all(std::begin(range), std::end(range))) {
+        return pin_all(std::begin(range), std::end(range));
+    }
+}
+}
+
+#endif // __PIN_ALL_H__
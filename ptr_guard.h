@@ -11,10 +11,28 @@
 #define __PTR_GUARD_H__
 
 #include <memory>
+#include <new>
 #include <functional>
+#include <cstring>
+#include <cstdint>
+#include <typeinfo>
+#include <array>
+#include <tuple>
+#include <utility>
 
 #if __cplusplus > 201402L
 #define __CPP17_SUPPORT__
+#include <optional>
+#endif
+
+#if __cplusplus > 201703L
+#define __CPP20_SUPPORT__
+#include <span>
+#endif
+
+#if defined(PTR_GUARD_REFCOUNT_AUDIT) && defined(__CPP20_SUPPORT__)
+#define __REFCOUNT_AUDIT__
+#include "refcount_audit.h"
 #endif
 
 namespace std {
@@ -34,6 +52,11 @@ namespace experimental {
     template <class T>
     using guard = ptr_guard<typename pointer_type_or_pointer_to_type<T>::type>;
 
+    // A non owning view of any guard of a T. It is trivially copyable and has the same enforced
+    // call only access, but must not outlive the guard it was constructed from.
+    template <class T>
+    using guard_ref = ptr_guard<T*>;
+
     namespace __detail {
         template <class G, class P>
         void ptr_guard_swap(G& guard, P& p1, P& p2) {
@@ -46,10 +69,10 @@ namespace experimental {
         }
 
         template <class T>
-        typename ptr_guard<T>::element_type& dereference_arg(ptr_guard<T> const& arg);
+        typename ptr_guard<T>::element_type& dereference_arg(ptr_guard<T> const& arg) noexcept;
 
         template <class T>
-        typename ptr_guard<T>::element_type& dereference_arg(ptr_guard<T>& arg);
+        typename ptr_guard<T>::element_type& dereference_arg(ptr_guard<T>& arg) noexcept;
 
         template <class T>
         typename ptr_guard<T>::pointer& access_guarded_pointer(ptr_guard<T>& arg);
@@ -64,10 +87,73 @@ namespace experimental {
         Ret check_all_then_invoke_or_default(Func&& func, Ret&& def, Args&&... args);
 
         template <class A, class... Args>
-        bool all_args_are_safe_to_dereference(A arg, Args&&... args);
+        bool all_args_are_safe_to_dereference(A const& arg, Args&&... args) noexcept;
 
         template <class T, class... Args>
-        bool all_args_are_safe_to_dereference(ptr_guard<T> const& arg, Args&&... args);
+        bool all_args_are_safe_to_dereference(ptr_guard<T> const& arg, Args&&... args) noexcept;
+
+        template <class A>
+        A&& dereference_arg(A&& arg) noexcept;
+
+        // Testing and dereferencing the guards never throws, so a call through guards is noexcept
+        // exactly when invoking the callable on the dereferenced arguments is.
+        template <class Func, class... Args>
+        using is_nothrow_guarded_call = is_nothrow_invocable<Func&, decltype(dereference_arg(declval<Args&>()))...>;
+
+        // call_or also copies the default out when a guard is null.
+        template <class Func, class Ret, class... Args>
+        using is_nothrow_guarded_call_or = integral_constant<bool,
+            is_nothrow_invocable_r<Ret, Func&, decltype(dereference_arg(declval<Args&>()))...>::value &&
+            is_nothrow_constructible<Ret, Ret&>::value>;
+
+#ifdef __CPP17_SUPPORT__
+        // Converting to the result type from the emplacer calls the function, so an optional
+        // constructed from the emplacer initializes its value directly from the returned prvalue.
+        template <class Make>
+        struct result_emplacer {
+            operator invoke_result_t<Make&>() const { return make(); }
+            Make& make;
+        };
+
+        struct any_argument { };
+
+        template <class R>
+        struct optional_result {
+            typedef optional<R> type;
+
+            template <class Make>
+            static type make(Make& make) {
+                // Types constructible from anything at all would capture the emplacer itself.
+                if constexpr (is_constructible<R, any_argument>::value) {
+                    return type(in_place, make());
+                } else {
+                    return type(in_place, result_emplacer<Make>{ make });
+                }
+            }
+        };
+
+        template <class R>
+        struct optional_result<R&> {
+            typedef ptr_guard<R*> type;
+
+            template <class Make>
+            static type make(Make& make) { return type(std::addressof(make())); }
+        };
+
+        template <class R>
+        struct optional_result<R&&> {
+            typedef optional<R> type;
+
+            template <class Make>
+            static type make(Make& make) { return type(in_place, make()); }
+        };
+
+        template <class Func, class... Args>
+        using call_optional_t = typename optional_result<invoke_result_t<Func&, decltype(dereference_arg(declval<Args&>()))...>>::type;
+
+        template <class Func, class... Args>
+        call_optional_t<Func, Args...> check_all_then_invoke_optional(Func&& func, Args&&... args);
+#endif
 
         auto get_use_count = [](auto&& ptr) { return ptr.use_count(); };
         auto release_ptr = [](auto&& ptr) { return ptr.release(); };
@@ -88,6 +174,47 @@ namespace experimental {
             p = arg;
         }
 
+#ifdef __CPP17_SUPPORT__
+        template <typename T>
+        void reset_ptr(optional<T>& p) {
+            p.reset();
+        }
+
+        template <typename T, typename... Args>
+        void reset_ptr(optional<T>& p, Args&&... args) {
+            p.emplace(std::forward<Args>(args)...);
+        }
+#endif
+
+#ifdef __REFCOUNT_AUDIT__
+        template <class P>
+        struct is_refcounted_pointer : false_type { };
+
+        template <class T>
+        struct is_refcounted_pointer<shared_ptr<T>> : true_type { };
+
+        template <class T>
+        struct is_refcounted_pointer<weak_ptr<T>> : true_type { };
+
+        template <class P>
+        void audit_refcount(refcount_op op, source_location const& site) {
+            if constexpr (is_refcounted_pointer<P>::value) { record_refcount_op(op, site); }
+        }
+
+        // Copying a reference counted lvalue into a guard takes a reference, while moving in a
+        // temporary, as lock() and the factories do, does not.
+        template <class P, class Source>
+        void audit_pointer_source(source_location const& site) {
+            typedef typename remove_cvref<Source>::type source_type;
+            if constexpr (is_lvalue_reference<Source>::value && is_refcounted_pointer<source_type>::value) {
+                audit_refcount<P>(is_same<source_type, P>::value ? refcount_op::copy : refcount_op::conversion, site);
+            }
+        }
+
+        template <class T>
+        struct is_ptr_guard;
+#endif
+
         template <typename P>
         bool test_ptr(const P& p) {
             return static_cast<bool>(p);
@@ -97,6 +224,89 @@ namespace experimental {
         bool test_ptr(const weak_ptr<T>& p) {
             return !p.expired();
         }
+
+        // A guard of a raw pointer constructed from a guard of an owning pointer borrows the
+        // pointee rather than sharing ownership, so passing it around costs no reference counting.
+        template <class To, class From>
+        using borrows_pointer = integral_constant<bool, is_pointer<To>::value && !is_constructible<To, From>::value>;
+
+        // A guard which borrowed from a temporary guard would be left dangling, so guard T may not
+        // be constructed or assigned from a temporary guard P it would borrow from.
+        template <class T, class P>
+        using borrows_from_temporary = borrows_pointer<typename ptr_guard<T>::pointer, typename ptr_guard<P>::pointer&&>;
+
+        template <class To, class From, class = typename enable_if<is_constructible<To, From&&>::value>::type>
+        To convert_guarded_pointer(From&& p, int) {
+            return To(std::forward<From>(p));
+        }
+
+        template <class To, class From, class = typename enable_if<is_pointer<To>::value>::type>
+        auto convert_guarded_pointer(From&& p, long) -> decltype(To(std::addressof(*p))) {
+            return test_ptr(p) ? std::addressof(*p) : nullptr;
+        }
+
+        template <typename P>
+        size_t hash_ptr(const P& p) {
+            return hash<P>()(p);
+        }
+
+        template <typename T>
+        size_t hash_ptr(const weak_ptr<T>& p) {
+#ifdef __cpp_lib_smart_ptr_owner_equality
+            return owner_hash()(p);
+#elif defined(__GLIBCXX__) || defined(_LIBCPP_VERSION) || defined(_MSVC_STL_VERSION)
+            // Weak pointers hash on their owner (the control block) so the hash agrees with the
+            // owner_before based equality and is stable after the pointee has expired. There is
+            // no portable access to the owner before owner_hash, but libstdc++, libc++ and the
+            // MSVC STL each store it as the second word of the weak_ptr.
+            static_assert(sizeof(weak_ptr<T>) == 2 * sizeof(void*), "Unexpected weak_ptr layout.");
+            const void* owner;
+            memcpy(&owner, reinterpret_cast<const char*>(&p) + sizeof(void*), sizeof(owner));
+            return hash<const void*>()(owner);
+#else
+#error "Hashing a weak_ptr by its owner needs owner_hash or a standard library with a known weak_ptr layout."
+#endif
+        }
+
+        template <typename P1, typename P2>
+        bool equal_ptr(const P1& p1, const P2& p2) {
+            return p1 == p2;
+        }
+
+        template <typename T, typename P2>
+        bool equal_ptr(const weak_ptr<T>& p1, const P2& p2) {
+            return !p1.owner_before(p2) && !p2.owner_before(p1);
+        }
+
+        template <typename P1, typename T>
+        bool equal_ptr(const P1& p1, const weak_ptr<T>& p2) {
+            return !p1.owner_before(p2) && !p2.owner_before(p1);
+        }
+
+        template <typename T1, typename T2>
+        bool equal_ptr(const weak_ptr<T1>& p1, const weak_ptr<T2>& p2) {
+            return !p1.owner_before(p2) && !p2.owner_before(p1);
+        }
+
+        template <typename P1, typename P2>
+        bool less_ptr(const P1& p1, const P2& p2) {
+            return less<>()(p1, p2);
+        }
+
+        template <typename T, typename P2>
+        bool less_ptr(const weak_ptr<T>& p1, const P2& p2) {
+            return p1.owner_before(p2);
+        }
+
+        template <typename P1, typename T>
+        bool less_ptr(const P1& p1, const weak_ptr<T>& p2) {
+            return p1.owner_before(p2);
+        }
+
+        template <typename T1, typename T2>
+        bool less_ptr(const weak_ptr<T1>& p1, const weak_ptr<T2>& p2) {
+            return p1.owner_before(p2);
+        }
     }
 
     template <class T>
@@ -108,21 +318,54 @@ namespace experimental {
     public:
         constexpr ptr_guard() noexcept;
 
+#ifdef __REFCOUNT_AUDIT__
+        template <class P> requires (!__detail::is_ptr_guard<typename remove_cvref<P>::type>::value)
+        ptr_guard(P&& other, source_location site = source_location::current()) noexcept;
+#else
         template <class P>
         ptr_guard(P other) noexcept;
+#endif
+#ifdef __REFCOUNT_AUDIT__
+        // Audited constructors record the location they are called from. Guards of pointers with
+        // reference counts are copied and moved through the converting constructors, as a copy
+        // constructor cannot take the location. Other guards keep their implicit copies and moves.
         template <class P>
-        ptr_guard(ptr_guard<P> const& other) noexcept;
+        ptr_guard(ptr_guard<P> const& other, source_location site = source_location::current()) noexcept;
+        template <class P, typename enable_if<!__detail::borrows_from_temporary<T, P>::value, int>::type = 0>
+        ptr_guard(ptr_guard<P>&& other, source_location site = source_location::current()) noexcept;
+        template <class P, typename enable_if<__detail::borrows_from_temporary<T, P>::value, int>::type = 0>
+        ptr_guard(ptr_guard<P>&& other, source_location site = source_location::current()) = delete;
+        ptr_guard(ptr_guard const& other) requires (!__detail::is_refcounted_pointer<pointer>::value) = default;
+        ptr_guard(ptr_guard&& other) requires (!__detail::is_refcounted_pointer<pointer>::value) = default;
+#else
         template <class P>
+        ptr_guard(ptr_guard<P> const& other) noexcept;
+        template <class P, typename enable_if<!__detail::borrows_from_temporary<T, P>::value, int>::type = 0>
         ptr_guard(ptr_guard<P>&& other) noexcept;
+        template <class P, typename enable_if<__detail::borrows_from_temporary<T, P>::value, int>::type = 0>
+        ptr_guard(ptr_guard<P>&& other) = delete;
         // move and copy constructors implicitely defined
+#endif
 
+#ifdef __REFCOUNT_AUDIT__
+        template <class P> requires (!__detail::is_ptr_guard<typename remove_cvref<P>::type>::value)
+        ptr_guard& operator =(P&& other) noexcept;
+#else
         template <class P>
         ptr_guard& operator =(P other) noexcept;
+#endif
         template <class P>
         ptr_guard& operator =(ptr_guard<P> const& other) noexcept;
-        template <class P>
+        template <class P, typename enable_if<!__detail::borrows_from_temporary<T, P>::value, int>::type = 0>
         ptr_guard& operator =(ptr_guard<P>&& other) noexcept;
+        template <class P, typename enable_if<__detail::borrows_from_temporary<T, P>::value, int>::type = 0>
+        ptr_guard& operator =(ptr_guard<P>&& other) = delete;
+#ifdef __REFCOUNT_AUDIT__
+        ptr_guard& operator =(ptr_guard const& other) requires (!__detail::is_refcounted_pointer<pointer>::value) = default;
+        ptr_guard& operator =(ptr_guard&& other) requires (!__detail::is_refcounted_pointer<pointer>::value) = default;
+#else
         // move and copy assignment implicitely defined
+#endif
 
         operator bool() const noexcept;
 
@@ -143,8 +386,13 @@ namespace experimental {
         template <class Released = decltype(__detail::release_ptr(std::declval<pointer>()))>
         Released release() noexcept;
 
+#ifdef __REFCOUNT_AUDIT__
+        template <class L = decltype(__detail::lock_ptr(std::declval<pointer>()))>
+        ptr_guard<L> lock(source_location site = source_location::current()) const noexcept;
+#else
         template <class L = decltype(__detail::lock_ptr(std::declval<pointer>()))>
         ptr_guard<L> lock() const noexcept;
+#endif
 
         template <class... Args>
         void reset(Args&&... args) noexcept;
@@ -153,20 +401,32 @@ namespace experimental {
         void swap(ptr_guard& other) noexcept;
 
         template <class Func, class... Args>
-        void call(Func&& func, Args&&... args) const;
+        void call(Func&& func, Args&&... args) const
+            noexcept(__detail::is_nothrow_guarded_call<Func, ptr_guard const&, Args...>::value);
 
         template <class Func, class... Args>
-        void call(Func&& func, Args&&... args);
+        void call(Func&& func, Args&&... args)
+            noexcept(__detail::is_nothrow_guarded_call<Func, ptr_guard&, Args...>::value);
 
         template <class Func, class Ret, class... Args>
-        Ret call_or(Func&& func, Ret&& def, Args&&... args) const;
+        Ret call_or(Func&& func, Ret&& def, Args&&... args) const
+            noexcept(__detail::is_nothrow_guarded_call_or<Func, Ret, ptr_guard const&, Args...>::value);
 
         template <class Func, class Ret, class... Args>
-        Ret call_or(Func&& func, Ret&& def, Args&&... args);
+        Ret call_or(Func&& func, Ret&& def, Args&&... args)
+            noexcept(__detail::is_nothrow_guarded_call_or<Func, Ret, ptr_guard&, Args...>::value);
+
+#ifdef __CPP17_SUPPORT__
+        template <class Func, class... Args>
+        __detail::call_optional_t<Func, ptr_guard const&, Args...> call_optional(Func&& func, Args&&... args) const;
+
+        template <class Func, class... Args>
+        __detail::call_optional_t<Func, ptr_guard&, Args...> call_optional(Func&& func, Args&&... args);
+#endif
 
     private:
-        friend typename element_type& __detail::dereference_arg(ptr_guard&);
-        friend typename element_type& __detail::dereference_arg(ptr_guard const&);
+        friend typename element_type& __detail::dereference_arg(ptr_guard&) noexcept;
+        friend typename element_type& __detail::dereference_arg(ptr_guard const&) noexcept;
 
         friend typename pointer& __detail::access_guarded_pointer(ptr_guard&);
         friend typename pointer const& __detail::access_guarded_pointer(ptr_guard const&);
@@ -178,25 +438,351 @@ namespace experimental {
         pointer _ptr = {};
     };
 
+#ifdef __CPP20_SUPPORT__
+    // A pointer to an array together with the size of the array, which a ptr_guard dereferences
+    // to a span over the whole array. The array is checked for null once per call rather than
+    // once per element. P is a T*, unique_ptr<T[]> or shared_ptr<T[]>, none of which know the
+    // size of the array themselves.
+    template <class P>
+    class array_ptr {
+    public:
+        typedef typename remove_extent<typename pointer_traits<P>::element_type>::type value_type;
+        typedef const span<value_type> element_type;
+        typedef ptrdiff_t difference_type;
+
+    public:
+        constexpr array_ptr() noexcept = default;
+        constexpr array_ptr(nullptr_t) noexcept { }
+        array_ptr(P p, size_t size) noexcept;
+        array_ptr(array_ptr const& other) = default;
+        array_ptr(array_ptr&& other) noexcept;
+
+        array_ptr& operator =(array_ptr const& other) = default;
+        array_ptr& operator =(array_ptr&& other) noexcept;
+
+        element_type& operator *() const noexcept { return _span; }
+        explicit operator bool() const noexcept { return _span.data() != nullptr; }
+
+        value_type* get() const noexcept { return _span.data(); }
+        size_t size() const noexcept { return _span.size(); }
+
+        void reset() noexcept;
+        void reset(P p, size_t size) noexcept;
+        void swap(array_ptr& other) noexcept;
+
+    private:
+        static value_type* data_of(P const& p) noexcept;
+
+        P _owner = P();
+        span<value_type> _span;
+    };
+#endif
+
+    template <class T, class... Args>
+    ptr_guard<T*> make_guarded(Args&&... args) {
+        return ptr_guard<T*>(new T(std::forward<Args>(args)...));
+    }
+
+    template <class T, class... Args>
+    typename enable_if<!is_array<T>::value, ptr_guard<unique_ptr<T>>>::type make_guarded_unique(Args&&... args) {
+        return ptr_guard<unique_ptr<T>>(make_unique<T>(std::forward<Args>(args)...));
+    }
+
+    template <class T, class... Args>
+    typename enable_if<!is_array<T>::value, ptr_guard<shared_ptr<T>>>::type make_guarded_shared(Args&&... args) {
+        return ptr_guard<shared_ptr<T>>(make_shared<T>(std::forward<Args>(args)...));
+    }
+
+#ifdef __CPP20_SUPPORT__
+    // The elements are default initialized, so a large buffer of trivial elements is not zeroed.
+    template <class T>
+    typename enable_if<is_unbounded_array<T>::value, ptr_guard<array_ptr<unique_ptr<T>>>>::type make_guarded_unique(size_t size) {
+        return array_ptr<unique_ptr<T>>(unique_ptr<T>(new typename remove_extent<T>::type[size]), size);
+    }
+
+    template <class T>
+    typename enable_if<is_unbounded_array<T>::value, ptr_guard<array_ptr<shared_ptr<T>>>>::type make_guarded_shared(size_t size) {
+#ifdef __cpp_lib_smart_ptr_for_overwrite
+        return array_ptr<shared_ptr<T>>(make_shared_for_overwrite<T>(size), size);
+#else
+        return array_ptr<shared_ptr<T>>(shared_ptr<T>(new typename remove_extent<T>::type[size]), size);
+#endif
+    }
+#endif
+
+    // The nothrow factories return a null guard when the allocation fails, rather than throwing
+    // bad_alloc, so they may be used in builds without exceptions. An exception thrown by the
+    // constructor of T is still propagated.
     template <class T, class... Args>
-    ptr_guard<T> make_guarded(Args&&... args) {
-        return ptr_guard(new T(args...));
+    ptr_guard<T*> make_guarded_nothrow(Args&&... args) {
+        return ptr_guard<T*>(new (nothrow) T(std::forward<Args>(args)...));
     }
 
     template <class T, class... Args>
-    ptr_guard<unique_ptr<T>> make_guarded_unique(Args&&... args) {
-        return ptr_guard<unique_ptr<T>>(make_unique(args...));
+    typename enable_if<!is_array<T>::value, ptr_guard<unique_ptr<T>>>::type make_guarded_unique_nothrow(Args&&... args) {
+        return ptr_guard<unique_ptr<T>>(unique_ptr<T>(new (nothrow) T(std::forward<Args>(args)...)));
+    }
+
+    // The shared_ptr control block is allocated along with T by make_shared, which has no nothrow
+    // form, so a bad_alloc from it is caught where exceptions are enabled. Where they are disabled
+    // a failure to allocate it is fatal, as it is for any allocation through the standard library.
+    template <class T, class... Args>
+    typename enable_if<!is_array<T>::value, ptr_guard<shared_ptr<T>>>::type make_guarded_shared_nothrow(Args&&... args) {
+#ifdef __cpp_exceptions
+        try {
+            return ptr_guard<shared_ptr<T>>(make_shared<T>(std::forward<Args>(args)...));
+        } catch (bad_alloc const&) {
+            return ptr_guard<shared_ptr<T>>();
+        }
+#else
+        return ptr_guard<shared_ptr<T>>(make_shared<T>(std::forward<Args>(args)...));
+#endif
     }
 
+#ifdef __CPP17_SUPPORT__
+    // A guard which holds its element in place, with reset(args...) constructing a new element
+    // in the guard. Small optional members guarded this way need no allocation or indirection.
+    template <class T>
+    using inline_guard = ptr_guard<optional<T>>;
+
     template <class T, class... Args>
-    ptr_guard<shared_ptr<T>> make_guarded_shared(Args&&... args) {
-        return ptr_guard<shared_ptr<T>>(make_shared(args...));
+    inline_guard<T> make_guarded_inline(Args&&... args) {
+        inline_guard<T> guard;
+        guard.reset(std::forward<Args>(args)...);
+        return guard;
+    }
+#endif
+
+    template <class T1, class T2>
+    bool operator ==(ptr_guard<T1> const& a, ptr_guard<T2> const& b) noexcept {
+        return __detail::equal_ptr(__detail::access_guarded_pointer(a), __detail::access_guarded_pointer(b));
+    }
+
+    template <class T1, class T2>
+    bool operator !=(ptr_guard<T1> const& a, ptr_guard<T2> const& b) noexcept {
+        return !(a == b);
+    }
+
+    template <class T>
+    bool operator ==(ptr_guard<T> const& a, nullptr_t) noexcept { return !a; }
+
+    template <class T>
+    bool operator !=(ptr_guard<T> const& a, nullptr_t) noexcept { return static_cast<bool>(a); }
+
+    template <class T>
+    bool operator ==(nullptr_t, ptr_guard<T> const& b) noexcept { return !b; }
+
+    template <class T>
+    bool operator !=(nullptr_t, ptr_guard<T> const& b) noexcept { return static_cast<bool>(b); }
+
+    template <class T1, class T2>
+    bool operator <(ptr_guard<T1> const& a, ptr_guard<T2> const& b) noexcept {
+        return __detail::less_ptr(__detail::access_guarded_pointer(a), __detail::access_guarded_pointer(b));
+    }
+
+    template <class T1, class T2>
+    bool operator >(ptr_guard<T1> const& a, ptr_guard<T2> const& b) noexcept { return b < a; }
+
+    template <class T1, class T2>
+    bool operator <=(ptr_guard<T1> const& a, ptr_guard<T2> const& b) noexcept { return !(b < a); }
+
+    template <class T1, class T2>
+    bool operator >=(ptr_guard<T1> const& a, ptr_guard<T2> const& b) noexcept { return !(a < b); }
+
+    namespace __detail {
+        struct static_cast_op {
+            template <class T, class U>
+            static T* apply(U* p) noexcept { return static_cast<T*>(p); }
+        };
+
+        struct const_cast_op {
+            template <class T, class U>
+            static T* apply(U* p) noexcept { return const_cast<T*>(p); }
+        };
+
+        struct reinterpret_cast_op {
+            template <class T, class U>
+            static T* apply(U* p) noexcept { return reinterpret_cast<T*>(p); }
+        };
+
+        struct dynamic_cast_op {
+            // Hot polymorphic dispatch tends to cast objects of the same few dynamic types
+            // repeatedly. The result of a dynamic_cast is fixed by the dynamic type and the
+            // position of the source subobject within the complete object, both of which are
+            // read straight from the vtable, so the adjustment is cached per thread against them.
+            template <class T, class U>
+            static T* apply(U* p) noexcept {
+                if (!p) { return nullptr; }
+
+                struct cache_entry {
+                    const type_info* type;
+                    ptrdiff_t offset;
+                    ptrdiff_t adjust;
+                    bool valid;
+                };
+                static thread_local cache_entry cache[4] = {};
+
+                const type_info* type = &typeid(*p);
+                intptr_t address = reinterpret_cast<intptr_t>(p);
+                ptrdiff_t offset = address - reinterpret_cast<intptr_t>(dynamic_cast<const volatile void*>(p));
+                cache_entry& entry = cache[(reinterpret_cast<uintptr_t>(type) >> 4 ^ static_cast<uintptr_t>(offset)) & 3];
+                if (entry.type == type && entry.offset == offset) {
+                    return entry.valid ? reinterpret_cast<T*>(address + entry.adjust) : nullptr;
+                }
+
+                T* result = dynamic_cast<T*>(p);
+                entry.type = type;
+                entry.offset = offset;
+                entry.adjust = result ? reinterpret_cast<intptr_t>(result) - address : 0;
+                entry.valid = result != nullptr;
+                return result;
+            }
+        };
+
+        template <class D, class T>
+        struct rebind_deleter {
+            typedef D type;
+            static D&& convert(D& deleter) noexcept { return std::move(deleter); }
+        };
+
+        template <class U, class T>
+        struct rebind_deleter<default_delete<U>, T> {
+            typedef default_delete<T> type;
+            static default_delete<T> convert(default_delete<U>&) noexcept { return default_delete<T>(); }
+        };
+
+        template <class T, class Cast, class U>
+        T* cast_ptr(U* p) noexcept {
+            return Cast::template apply<T>(p);
+        }
+
+        template <class T, class Cast, class U>
+        shared_ptr<T> cast_ptr(const shared_ptr<U>& p) noexcept {
+            T* cast = Cast::template apply<T>(p.get());
+            return cast ? shared_ptr<T>(p, cast) : shared_ptr<T>();
+        }
+
+        template <class T, class Cast, class U>
+        shared_ptr<T> cast_ptr(shared_ptr<U>&& p) noexcept {
+            T* cast = Cast::template apply<T>(p.get());
+            if (!cast) { return shared_ptr<T>(); }
+#ifdef __CPP20_SUPPORT__
+            return shared_ptr<T>(std::move(p), cast);
+#else
+            shared_ptr<T> result(p, cast);
+            p.reset();
+            return result;
+#endif
+        }
+
+        template <class T, class Cast, class U>
+        weak_ptr<T> cast_ptr(const weak_ptr<U>& p) noexcept {
+            return cast_ptr<T, Cast>(p.lock());
+        }
+
+        template <class T, class Cast, class U, class D>
+        unique_ptr<T, typename rebind_deleter<D, T>::type> cast_ptr(unique_ptr<U, D>&& p) noexcept {
+            // Ownership only transfers when the cast succeeds, as for the shared_ptr casts.
+            T* cast = Cast::template apply<T>(p.get());
+            if (!cast) { return unique_ptr<T, typename rebind_deleter<D, T>::type>(); }
+            p.release();
+            return unique_ptr<T, typename rebind_deleter<D, T>::type>(cast, rebind_deleter<D, T>::convert(p.get_deleter()));
+        }
+    }
+
+    template <class T, class U>
+    auto static_pointer_cast(ptr_guard<U> const& r) noexcept
+        -> ptr_guard<decltype(__detail::cast_ptr<T, __detail::static_cast_op>(__detail::access_guarded_pointer(r)))> {
+        return __detail::cast_ptr<T, __detail::static_cast_op>(__detail::access_guarded_pointer(r));
+    }
+
+    template <class T, class U>
+    auto static_pointer_cast(ptr_guard<U>&& r) noexcept
+        -> ptr_guard<decltype(__detail::cast_ptr<T, __detail::static_cast_op>(__detail::access_guarded_pointer(std::move(r))))> {
+        return __detail::cast_ptr<T, __detail::static_cast_op>(__detail::access_guarded_pointer(std::move(r)));
+    }
+
+    template <class T, class U>
+    auto dynamic_pointer_cast(ptr_guard<U> const& r) noexcept
+        -> ptr_guard<decltype(__detail::cast_ptr<T, __detail::dynamic_cast_op>(__detail::access_guarded_pointer(r)))> {
+        return __detail::cast_ptr<T, __detail::dynamic_cast_op>(__detail::access_guarded_pointer(r));
+    }
+
+    template <class T, class U>
+    auto dynamic_pointer_cast(ptr_guard<U>&& r) noexcept
+        -> ptr_guard<decltype(__detail::cast_ptr<T, __detail::dynamic_cast_op>(__detail::access_guarded_pointer(std::move(r))))> {
+        return __detail::cast_ptr<T, __detail::dynamic_cast_op>(__detail::access_guarded_pointer(std::move(r)));
+    }
+
+    template <class T, class U>
+    auto const_pointer_cast(ptr_guard<U> const& r) noexcept
+        -> ptr_guard<decltype(__detail::cast_ptr<T, __detail::const_cast_op>(__detail::access_guarded_pointer(r)))> {
+        return __detail::cast_ptr<T, __detail::const_cast_op>(__detail::access_guarded_pointer(r));
+    }
+
+    template <class T, class U>
+    auto const_pointer_cast(ptr_guard<U>&& r) noexcept
+        -> ptr_guard<decltype(__detail::cast_ptr<T, __detail::const_cast_op>(__detail::access_guarded_pointer(std::move(r))))> {
+        return __detail::cast_ptr<T, __detail::const_cast_op>(__detail::access_guarded_pointer(std::move(r)));
+    }
+
+    template <class T, class U>
+    auto reinterpret_pointer_cast(ptr_guard<U> const& r) noexcept
+        -> ptr_guard<decltype(__detail::cast_ptr<T, __detail::reinterpret_cast_op>(__detail::access_guarded_pointer(r)))> {
+        return __detail::cast_ptr<T, __detail::reinterpret_cast_op>(__detail::access_guarded_pointer(r));
     }
 
-#ifdef __CPP17_SUPPORT
     template <class T, class U>
-    ptr_guard<shared_ptr<T>> reinterpret_pointer_cast(const ptr_guard<shared_ptr<U>>& other) noexcept {
-        return reinterpret_pointer_cast<T>(other.pointer);
+    auto reinterpret_pointer_cast(ptr_guard<U>&& r) noexcept
+        -> ptr_guard<decltype(__detail::cast_ptr<T, __detail::reinterpret_cast_op>(__detail::access_guarded_pointer(std::move(r))))> {
+        return __detail::cast_ptr<T, __detail::reinterpret_cast_op>(__detail::access_guarded_pointer(std::move(r)));
+    }
+
+#ifdef __CPP20_SUPPORT__
+    template <class P>
+    array_ptr<P>::array_ptr(P p, size_t size) noexcept
+      : _owner(std::move(p)), _span(data_of(_owner), data_of(_owner) ? size : 0) { }
+
+    template <class P>
+    array_ptr<P>::array_ptr(array_ptr&& other) noexcept
+      : _owner(std::move(other._owner)), _span(other._span) {
+        other.reset();
+    }
+
+    template <class P>
+    array_ptr<P>& array_ptr<P>::operator =(array_ptr&& other) noexcept {
+        if (this != &other) {
+            _owner = std::move(other._owner);
+            _span = other._span;
+            other.reset();
+        }
+        return *this;
+    }
+
+    template <class P>
+    void array_ptr<P>::reset() noexcept {
+        _owner = P();
+        _span = span<value_type>();
+    }
+
+    template <class P>
+    void array_ptr<P>::reset(P p, size_t size) noexcept {
+        *this = array_ptr(std::move(p), size);
+    }
+
+    template <class P>
+    void array_ptr<P>::swap(array_ptr& other) noexcept {
+        std::swap(_owner, other._owner);
+        std::swap(_span, other._span);
+    }
+
+    template <class P>
+    typename array_ptr<P>::value_type* array_ptr<P>::data_of(P const& p) noexcept {
+        if constexpr (is_pointer<P>::value) {
+            return p;
+        } else {
+            return p.get();
+        }
     }
 #endif
 
@@ -206,38 +792,78 @@ namespace experimental {
     template <class T>
     constexpr ptr_guard<T>::ptr_guard() noexcept = default;
 
+#ifdef __REFCOUNT_AUDIT__
+    template <class T>
+    template <class P> requires (!__detail::is_ptr_guard<typename remove_cvref<P>::type>::value)
+    ptr_guard<T>::ptr_guard(P&& other, source_location site) noexcept : _ptr(std::forward<P>(other)) {
+        __detail::audit_pointer_source<pointer, P>(site);
+    }
+#else
     template <class T>
     template <class P>
     ptr_guard<T>::ptr_guard(P other) noexcept : _ptr(std::forward<P>(other)) { }
+#endif
 
+#ifdef __REFCOUNT_AUDIT__
     template <class T>
     template <class P>
-    ptr_guard<T>::ptr_guard(ptr_guard<P> const& other) noexcept
-      : _ptr(__detail::access_guarded_pointer(other)) { }
+    ptr_guard<T>::ptr_guard(ptr_guard<P> const& other, source_location site) noexcept
+      : _ptr(__detail::convert_guarded_pointer<pointer>(__detail::access_guarded_pointer(other), 0)) {
+        __detail::audit_refcount<pointer>(is_same<P, T>::value ? refcount_op::copy : refcount_op::conversion, site);
+    }
 
+    template <class T>
+    template <class P, typename enable_if<!__detail::borrows_from_temporary<T, P>::value, int>::type>
+    ptr_guard<T>::ptr_guard(ptr_guard<P>&& other, source_location site) noexcept
+      : _ptr(__detail::convert_guarded_pointer<pointer>(__detail::access_guarded_pointer(std::move(other)), 0)) {
+        __detail::audit_refcount<pointer>(refcount_op::move, site);
+    }
+#else
     template <class T>
     template <class P>
+    ptr_guard<T>::ptr_guard(ptr_guard<P> const& other) noexcept
+      : _ptr(__detail::convert_guarded_pointer<pointer>(__detail::access_guarded_pointer(other), 0)) { }
+
+    template <class T>
+    template <class P, typename enable_if<!__detail::borrows_from_temporary<T, P>::value, int>::type>
     ptr_guard<T>::ptr_guard(ptr_guard<P>&& other) noexcept
-      : _ptr(__detail::access_guarded_pointer(other)) { }
+      : _ptr(__detail::convert_guarded_pointer<pointer>(__detail::access_guarded_pointer(std::move(other)), 0)) { }
+#endif
 
+#ifdef __REFCOUNT_AUDIT__
+    template <class T>
+    template <class P> requires (!__detail::is_ptr_guard<typename remove_cvref<P>::type>::value)
+    ptr_guard<T>& ptr_guard<T>::operator =(P&& other) noexcept {
+        __detail::audit_pointer_source<pointer, P>(source_location::current());
+        _ptr = std::forward<P>(other);
+        return *this;
+    }
+#else
     template <class T>
     template <class P>
     ptr_guard<T>& ptr_guard<T>::operator =(P other) noexcept {
         _ptr = std::forward<P>(other);
         return *this;
     }
+#endif
 
     template <class T>
     template <class P>
     ptr_guard<T>& ptr_guard<T>::operator =(ptr_guard<P> const& other) noexcept {
-        _ptr = other._ptr;
+#ifdef __REFCOUNT_AUDIT__
+        __detail::audit_refcount<pointer>(is_same<P, T>::value ? refcount_op::copy : refcount_op::conversion, source_location::current());
+#endif
+        _ptr = __detail::convert_guarded_pointer<pointer>(__detail::access_guarded_pointer(other), 0);
         return *this;
     }
 
     template <class T>
-    template <class P>
+    template <class P, typename enable_if<!__detail::borrows_from_temporary<T, P>::value, int>::type>
     ptr_guard<T>& ptr_guard<T>::operator =(ptr_guard<P>&& other) noexcept {
-        _ptr = std::move(other._ptr);
+#ifdef __REFCOUNT_AUDIT__
+        __detail::audit_refcount<pointer>(refcount_op::move, source_location::current());
+#endif
+        _ptr = __detail::convert_guarded_pointer<pointer>(__detail::access_guarded_pointer(std::move(other)), 0);
         return *this;
     }
 
@@ -274,7 +900,7 @@ namespace experimental {
     template <class T>
     template <class... Args>
     void ptr_guard<T>::reset(Args&&... args) noexcept {
-        __detail::reset_ptr(_ptr, args...);
+        __detail::reset_ptr(_ptr, std::forward<Args>(args)...);
     }
 
     template <class T>
@@ -293,11 +919,20 @@ namespace experimental {
         return _ptr.release();
     }
 
+#ifdef __REFCOUNT_AUDIT__
+    template <class T>
+    template <class L>
+    ptr_guard<L> ptr_guard<T>::lock(source_location site) const noexcept {
+        __detail::audit_refcount<pointer>(refcount_op::lock, site);
+        return _ptr.lock();
+    }
+#else
     template <class T>
     template <class L>
     ptr_guard<L> ptr_guard<T>::lock() const noexcept {
         return _ptr.lock();
     }
+#endif
 
     template <class T>
     typename ptr_guard<T>::element_type const& ptr_guard<T>::operator *() const noexcept { return *_ptr; }
@@ -307,7 +942,8 @@ namespace experimental {
 
     template <class T>
     template <class Func, class... Args>
-    void ptr_guard<T>::call(Func&& func, Args&&... args) const {
+    void ptr_guard<T>::call(Func&& func, Args&&... args) const
+        noexcept(__detail::is_nothrow_guarded_call<Func, ptr_guard const&, Args...>::value) {
         __detail::check_all_then_invoke<Func, ptr_guard const&, Args...>(
             std::forward<Func&&>(func),
             *this,
@@ -316,7 +952,8 @@ namespace experimental {
 
     template <class T>
     template <class Func, class... Args>
-    void ptr_guard<T>::call(Func&& func, Args&&... args) {
+    void ptr_guard<T>::call(Func&& func, Args&&... args)
+        noexcept(__detail::is_nothrow_guarded_call<Func, ptr_guard&, Args...>::value) {
         __detail::check_all_then_invoke<Func, ptr_guard&, Args...>(
             std::forward<Func&&>(func),
             *this,
@@ -325,7 +962,8 @@ namespace experimental {
 
     template <class T>
     template <class Func, class Ret, class... Args>
-    Ret ptr_guard<T>::call_or(Func&& func, Ret&& def, Args&&... args) const {
+    Ret ptr_guard<T>::call_or(Func&& func, Ret&& def, Args&&... args) const
+        noexcept(__detail::is_nothrow_guarded_call_or<Func, Ret, ptr_guard const&, Args...>::value) {
         return __detail::check_all_then_invoke_or_default<Func, Ret, ptr_guard const&, Args...>(
             std::forward<Func&&>(func),
             std::forward<Ret&&>(def),
@@ -335,7 +973,8 @@ namespace experimental {
 
     template <class T>
     template <class Func, class Ret, class... Args>
-    Ret ptr_guard<T>::call_or(Func&& func, Ret&& def, Args&&... args) {
+    Ret ptr_guard<T>::call_or(Func&& func, Ret&& def, Args&&... args)
+        noexcept(__detail::is_nothrow_guarded_call_or<Func, Ret, ptr_guard&, Args...>::value) {
         return __detail::check_all_then_invoke_or_default<Func, Ret, ptr_guard&, Args...>(
             std::forward<Func&&>(func),
             std::forward<Ret&&>(def),
@@ -343,37 +982,58 @@ namespace experimental {
             std::forward<Args&&>(args)...);
     }
 
+#ifdef __CPP17_SUPPORT__
+    template <class T>
+    template <class Func, class... Args>
+    __detail::call_optional_t<Func, ptr_guard<T> const&, Args...> ptr_guard<T>::call_optional(Func&& func, Args&&... args) const {
+        return __detail::check_all_then_invoke_optional<Func, ptr_guard const&, Args...>(
+            std::forward<Func&&>(func),
+            *this,
+            std::forward<Args&&>(args)...);
+    }
+
+    template <class T>
+    template <class Func, class... Args>
+    __detail::call_optional_t<Func, ptr_guard<T>&, Args...> ptr_guard<T>::call_optional(Func&& func, Args&&... args) {
+        return __detail::check_all_then_invoke_optional<Func, ptr_guard&, Args...>(
+            std::forward<Func&&>(func),
+            *this,
+            std::forward<Args&&>(args)...);
+    }
+#endif
+
     namespace __detail {
-        inline bool all_args_are_safe_to_dereference() { return true; }
+        inline bool all_args_are_safe_to_dereference() noexcept { return true; }
 
+        // Arguments which are not guards are taken by reference, so checking them copies nothing.
         template <class A>
-        bool all_args_are_safe_to_dereference(A arg) {
+        bool all_args_are_safe_to_dereference(A const& arg) noexcept {
             return true;
         }
 
         template <class T>
-        bool all_args_are_safe_to_dereference(ptr_guard<T> const& arg) {
+        bool all_args_are_safe_to_dereference(ptr_guard<T> const& arg) noexcept {
             return static_cast<bool>(arg);
         }
 
         template <class A, class... Args>
-        bool all_args_are_safe_to_dereference(A arg, Args&&... args) {
+        bool all_args_are_safe_to_dereference(A const& arg, Args&&... args) noexcept {
             return all_args_are_safe_to_dereference(args...);
         }
 
         template <class T, class... Args>
-        bool all_args_are_safe_to_dereference(ptr_guard<T> const& arg, Args&&... args) {
+        bool all_args_are_safe_to_dereference(ptr_guard<T> const& arg, Args&&... args) noexcept {
             return static_cast<bool>(arg) && all_args_are_safe_to_dereference(args...);
         }
 
         template <class A>
-        A&& dereference_arg(A&& arg) { return std::forward<A&&>(arg); }
+        A&& dereference_arg(A&& arg) noexcept { return std::forward<A&&>(arg); }
 
         template <class T>
-        typename ptr_guard<T>::element_type& dereference_arg(ptr_guard<T> const& arg) { return *const_cast<ptr_guard<T>&>(arg); }
+        typename ptr_guard<T>::element_type& dereference_arg(ptr_guard<T> const& arg) noexcept { return *const_cast<ptr_guard<T>&>(arg); }
 
         template <class T>
-        typename ptr_guard<T>::element_type& dereference_arg(ptr_guard<T>& arg) { return *arg; }
+        typename ptr_guard<T>::element_type& dereference_arg(ptr_guard<T>& arg) noexcept { return *arg; }
 
         template <class T>
         typename ptr_guard<T>::pointer& access_guarded_pointer(ptr_guard<T>& arg) { return arg._ptr; }
@@ -396,12 +1056,149 @@ namespace experimental {
             if (!all_args_are_safe_to_dereference(std::forward<Args&&>(args)...)) { return def; }
             return std::invoke(func, dereference_arg(args)...);
         }
+
+#ifdef __CPP17_SUPPORT__
+        template <class Func, class... Args>
+        call_optional_t<Func, Args...> check_all_then_invoke_optional(Func&& func, Args&&... args) {
+            typedef invoke_result_t<Func&, decltype(dereference_arg(declval<Args&>()))...> result_type;
+            if (!all_args_are_safe_to_dereference(std::forward<Args&&>(args)...)) { return call_optional_t<Func, Args...>(); }
+            auto make = [&]() -> result_type { return std::invoke(func, dereference_arg(args)...); };
+            return optional_result<result_type>::make(make);
+        }
+#endif
+    }
+
+#ifdef __CPP17_SUPPORT__
+    namespace __detail {
+        template <class T>
+        struct is_ptr_guard : false_type { };
+
+        template <class T>
+        struct is_ptr_guard<ptr_guard<T>> : true_type { };
+
+        template <class... Args>
+        struct leading_guard_count : integral_constant<size_t, 0> { };
+
+        template <class A, class... Args>
+        struct leading_guard_count<A, Args...>
+          : integral_constant<size_t, is_ptr_guard<typename decay<A>::type>::value ? 1 + leading_guard_count<Args...>::value : 0> { };
+
+        template <class Handler, class ArgTuple>
+        struct is_applicable : false_type { };
+
+        template <class Handler, class... Args>
+        struct is_applicable<Handler, tuple<Args...>> : is_invocable<Handler&, Args...> { };
+
+        // The arguments for a combination of valid guards, either leaving out the null guards or
+        // passing nullopt in their place.
+        template <size_t Mask, size_t I, class G>
+        auto match_arg(G& guard, false_type) {
+            if constexpr (((Mask >> I) & 1) != 0) {
+                return tuple<decltype(dereference_arg(guard))>(dereference_arg(guard));
+            } else {
+                return tuple<>();
+            }
+        }
+
+        template <size_t Mask, size_t I, class G>
+        auto match_arg(G& guard, true_type) {
+            if constexpr (((Mask >> I) & 1) != 0) {
+                return tuple<decltype(dereference_arg(guard))>(dereference_arg(guard));
+            } else {
+                return tuple<nullopt_t>(nullopt);
+            }
+        }
+
+        template <class Omitted, class WithNullopt, class... Handlers>
+        constexpr size_t select_match_handler() {
+            constexpr bool matches[] = {
+                (is_applicable<Handlers, Omitted>::value || is_applicable<Handlers, WithNullopt>::value)..., false };
+            for (size_t i = 0; i < sizeof...(Handlers); ++i) {
+                if (matches[i]) { return i; }
+            }
+            return sizeof...(Handlers);
+        }
+
+        template <class HandlerTuple, class GuardTuple, class Indices>
+        struct match_table;
+
+        template <class... Handlers, class... Guards, size_t... Is>
+        struct match_table<tuple<Handlers...>, tuple<Guards...>, index_sequence<Is...>> {
+            typedef tuple<Handlers...> handlers_type;
+            typedef tuple<Guards...> guards_type;
+            typedef void (*entry_type)(handlers_type&, guards_type&);
+
+            template <size_t Mask>
+            static void dispatch(handlers_type& handlers, guards_type& guards) {
+                typedef decltype(tuple_cat(match_arg<Mask, Is>(get<Is>(guards), false_type())...)) omitted_type;
+                typedef decltype(tuple_cat(match_arg<Mask, Is>(get<Is>(guards), true_type())...)) with_nullopt_type;
+                constexpr size_t handler = select_match_handler<omitted_type, with_nullopt_type, Handlers...>();
+                if constexpr (handler < sizeof...(Handlers)) {
+                    typedef typename tuple_element<handler, handlers_type>::type handler_type;
+                    constexpr bool omitNulls = is_applicable<handler_type, omitted_type>::value;
+                    std::apply(get<handler>(handlers), tuple_cat(match_arg<Mask, Is>(get<Is>(guards), bool_constant<!omitNulls>())...));
+                }
+            }
+
+            template <size_t... Masks>
+            static constexpr array<entry_type, sizeof...(Masks)> make_table(index_sequence<Masks...>) {
+                return {{ &dispatch<Masks>... }};
+            }
+
+            static void call(handlers_type& handlers, guards_type& guards) {
+                static constexpr array<entry_type, size_t(1) << sizeof...(Guards)> table =
+                    make_table(make_index_sequence<size_t(1) << sizeof...(Guards)>());
+
+                size_t mask = 0;
+                ((mask |= static_cast<size_t>(static_cast<bool>(get<Is>(guards))) << Is), ...);
+                table[mask](handlers, guards);
+            }
+        };
+
+        template <size_t GuardCount, class ArgTuple, size_t... Is, size_t... Js>
+        void call_match_split(ArgTuple&& args, index_sequence<Is...>, index_sequence<Js...>) {
+            auto guards = forward_as_tuple(get<Is>(std::move(args))...);
+            auto handlers = forward_as_tuple(get<GuardCount + Js>(std::move(args))...);
+            match_table<decltype(handlers), decltype(guards), index_sequence<Is...>>::call(handlers, guards);
+        }
+    }
+
+    // Invokes the first handler accepting the elements of the non null guards, with the null
+    // guards either left out of the arguments or passed as nullopt. Each guard is tested once
+    // and the handler for the combination of valid guards found through a table. Combinations
+    // which no handler accepts are not handled.
+    template <class... Args>
+    void call_match(Args&&... args) {
+        constexpr size_t guardCount = __detail::leading_guard_count<Args...>::value;
+        static_assert(guardCount > 0 && guardCount < sizeof...(Args), "call_match takes one or more guards followed by the handlers.");
+        static_assert(guardCount <= 8, "call_match dispatches on at most eight guards.");
+
+        __detail::call_match_split<guardCount>(
+            forward_as_tuple(std::forward<Args>(args)...),
+            make_index_sequence<guardCount>(),
+            make_index_sequence<sizeof...(Args) - guardCount>());
     }
+#endif
 }
+
+    template <class T>
+    struct hash<experimental::ptr_guard<T>> {
+        size_t operator ()(experimental::ptr_guard<T> const& guard) const noexcept {
+            return experimental::__detail::hash_ptr(experimental::__detail::access_guarded_pointer(guard));
+        }
+    };
 }
 
 #ifdef __CPP17_SUPPORT__
 #undef __CPP17_SUPPORT__
 #endif // __CPP17_SUPPORT__
 
+#ifdef __CPP20_SUPPORT__
+#undef __CPP20_SUPPORT__
+#endif // __CPP20_SUPPORT__
+
+#ifdef __REFCOUNT_AUDIT__
+#undef __REFCOUNT_AUDIT__
+#endif // __REFCOUNT_AUDIT__
+
 #endif // __PTR_GUARD_H__
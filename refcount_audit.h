@@ -0,0 +1,182 @@
+/**
+ * Counting of the reference count traffic caused by guards of shared and weak pointers. When
+ * PTR_GUARD_REFCOUNT_AUDIT is defined before ptr_guard.h is included, with C++20, every copy,
+ * move, conversion and lock() of a ptr_guard<shared_ptr<T>> or ptr_guard<weak_ptr<T>> is
+ * counted against its source location. Without the macro ptr_guard is unchanged and nothing is
+ * counted, so the audit costs nothing unless it is built in.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __REFCOUNT_AUDIT_H__
+#define __REFCOUNT_AUDIT_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <source_location>
+#include <unordered_map>
+#include <vector>
+
+namespace std {
+namespace experimental {
+    enum class refcount_op { copy, move, conversion, lock };
+
+    // The operations counted at one source location. Copies, conversions and locks each take a
+    // reference, moves do not. Constructors and lock() are counted where they are called, but an
+    // assignment operator cannot be passed its caller's location, so assignments are counted
+    // against the assignment operator itself.
+    struct refcount_audit_site {
+        const char* file;
+        uint_least32_t line;
+        uint_least32_t column;
+        const char* function;
+        uint64_t copies = 0;
+        uint64_t moves = 0;
+        uint64_t conversions = 0;
+        uint64_t locks = 0;
+
+        uint64_t refcount_operations() const noexcept { return copies + conversions + locks; }
+    };
+
+    // The top sites by reference count operations, summed over the operations of every thread.
+    vector<refcount_audit_site> refcount_audit_report(size_t top = 20);
+
+    void print_refcount_audit(FILE* out = stderr, size_t top = 20);
+
+    void reset_refcount_audit();
+
+    namespace __detail {
+        struct refcount_audit_key {
+            const char* file;
+            uint_least32_t line;
+            uint_least32_t column;
+
+            bool operator ==(refcount_audit_key const& other) const noexcept {
+                return file == other.file && line == other.line && column == other.column;
+            }
+        };
+
+        struct refcount_audit_key_hash {
+            size_t operator ()(refcount_audit_key const& key) const noexcept {
+                uint64_t h = (reinterpret_cast<uintptr_t>(key.file) * 0x9E3779B97F4A7C15ull) ^ (uint64_t(key.line) << 20) ^ key.column;
+                return static_cast<size_t>(h ^ (h >> 32));
+            }
+        };
+
+        // Each thread counts in a table of its own, so counting is not contended. The table's
+        // lock is only contended while a report is being taken.
+        struct refcount_audit_table {
+            mutex lock;
+            unordered_map<refcount_audit_key, refcount_audit_site, refcount_audit_key_hash> sites;
+        };
+
+        // The tables of threads which have exited are kept so their counts are still reported.
+        struct refcount_audit_registry {
+            mutex lock;
+            vector<shared_ptr<refcount_audit_table>> tables;
+
+            static refcount_audit_registry& instance();
+        };
+
+        refcount_audit_table& this_thread_refcount_audit();
+
+        void record_refcount_op(refcount_op op, source_location const& site);
+
+        inline bool same_refcount_audit_site(refcount_audit_site const& a, refcount_audit_site const& b) noexcept {
+            return a.line == b.line && a.column == b.column && strcmp(a.file, b.file) == 0;
+        }
+    }
+
+    inline __detail::refcount_audit_registry& __detail::refcount_audit_registry::instance() {
+        static refcount_audit_registry registry;
+        return registry;
+    }
+
+    inline __detail::refcount_audit_table& __detail::this_thread_refcount_audit() {
+        thread_local shared_ptr<refcount_audit_table> table = [] {
+            auto created = make_shared<refcount_audit_table>();
+            refcount_audit_registry& registry = refcount_audit_registry::instance();
+            lock_guard<mutex> lock(registry.lock);
+            registry.tables.push_back(created);
+            return created;
+        }();
+        return *table;
+    }
+
+    inline void __detail::record_refcount_op(refcount_op op, source_location const& site) {
+        refcount_audit_table& table = this_thread_refcount_audit();
+        // The file name of a location is a string literal, so its address identifies the file
+        // within one translation unit. Sites are merged across translation units by the report.
+        refcount_audit_key key{ site.file_name(), site.line(), site.column() };
+
+        lock_guard<mutex> lock(table.lock);
+        auto result = table.sites.try_emplace(key, refcount_audit_site{ site.file_name(), site.line(), site.column(), site.function_name() });
+        refcount_audit_site& counts = result.first->second;
+        switch (op) {
+        case refcount_op::copy: ++counts.copies; break;
+        case refcount_op::move: ++counts.moves; break;
+        case refcount_op::conversion: ++counts.conversions; break;
+        case refcount_op::lock: ++counts.locks; break;
+        }
+    }
+
+    inline vector<refcount_audit_site> refcount_audit_report(size_t top) {
+        vector<refcount_audit_site> merged;
+        __detail::refcount_audit_registry& registry = __detail::refcount_audit_registry::instance();
+        lock_guard<mutex> registryLock(registry.lock);
+        for (shared_ptr<__detail::refcount_audit_table> const& table : registry.tables) {
+            lock_guard<mutex> tableLock(table->lock);
+            for (auto const& entry : table->sites) {
+                refcount_audit_site const& site = entry.second;
+                auto it = find_if(merged.begin(), merged.end(), [&site](refcount_audit_site const& m) {
+                    return __detail::same_refcount_audit_site(m, site);
+                });
+                if (it == merged.end()) {
+                    merged.push_back(site);
+                    continue;
+                }
+                it->copies += site.copies;
+                it->moves += site.moves;
+                it->conversions += site.conversions;
+                it->locks += site.locks;
+            }
+        }
+
+        sort(merged.begin(), merged.end(), [](refcount_audit_site const& a, refcount_audit_site const& b) {
+            if (a.refcount_operations() != b.refcount_operations()) { return a.refcount_operations() > b.refcount_operations(); }
+            return a.moves > b.moves;
+        });
+        if (merged.size() > top) { merged.resize(top); }
+        return merged;
+    }
+
+    inline void print_refcount_audit(FILE* out, size_t top) {
+        fprintf(out, "%12s %12s %12s %12s %12s  %s\n", "refcounts", "copies", "conversions", "locks", "moves", "site");
+        for (refcount_audit_site const& site : refcount_audit_report(top)) {
+            fprintf(out, "%12llu %12llu %12llu %12llu %12llu  %s:%u %s\n",
+                    static_cast<unsigned long long>(site.refcount_operations()),
+                    static_cast<unsigned long long>(site.copies),
+                    static_cast<unsigned long long>(site.conversions),
+                    static_cast<unsigned long long>(site.locks),
+                    static_cast<unsigned long long>(site.moves),
+                    site.file, static_cast<unsigned>(site.line), site.function);
+        }
+    }
+
+    inline void reset_refcount_audit() {
+        __detail::refcount_audit_registry& registry = __detail::refcount_audit_registry::instance();
+        lock_guard<mutex> registryLock(registry.lock);
+        for (shared_ptr<__detail::refcount_audit_table> const& table : registry.tables) {
+            lock_guard<mutex> tableLock(table->lock);
+            table->sites.clear();
+        }
+    }
+}
+}
+
+#endif // __REFCOUNT_AUDIT_H__
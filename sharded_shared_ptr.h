@@ -0,0 +1,251 @@
+/**
+ * A shared owning pointer whose reference count is split into per thread shards. Copies made on
+ * different threads count references in different cache lines, so an object shared by every
+ * worker thread does not have all of its copies contend on a single count as shared_ptr does.
+ * The pointer satisfies pointer_traits so ptr_guard<sharded_shared_ptr<T>> guards it like any
+ * other pointer.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __SHARDED_SHARED_PTR_H__
+#define __SHARDED_SHARED_PTR_H__
+
+#include "ptr_guard.h"
+
+#include <atomic>
+#include <thread>
+
+namespace std {
+namespace experimental {
+    namespace __detail {
+        struct alignas(64) reference_shard {
+            atomic<long> count{ 0 };
+        };
+
+        // The central count holds one reference for each shard with a non zero count, and the
+        // object is destroyed when it reaches zero. A shard takes its central reference before
+        // its count leaves zero and gives it back after its count returns to zero, so the
+        // central count cannot reach zero while any shard still counts a reference.
+        struct sharded_control {
+            atomic<long> central{ 0 };
+            size_t mask;
+            reference_shard* shards;
+            void (*destroy)(sharded_control*);
+        };
+
+        template <class T>
+        struct sharded_control_for : sharded_control {
+            T* object;
+        };
+
+        inline size_t reference_shard_count() noexcept {
+            static const size_t count = [] {
+                size_t threads = thread::hardware_concurrency();
+                size_t shards = 1;
+                while (shards < threads && shards < 64) { shards *= 2; }
+                return shards;
+            }();
+            return count;
+        }
+
+        inline size_t this_thread_shard() noexcept {
+            static atomic<size_t> next(0);
+            thread_local size_t shard = next.fetch_add(1, memory_order_relaxed);
+            return shard;
+        }
+
+        inline size_t acquire_shard(sharded_control* control) noexcept {
+            size_t index = this_thread_shard() & control->mask;
+            atomic<long>& count = control->shards[index].count;
+            long current = count.load(memory_order_relaxed);
+            for (;;) {
+                if (current) {
+                    if (count.compare_exchange_weak(current, current + 1, memory_order_relaxed)) { return index; }
+                    continue;
+                }
+                control->central.fetch_add(1, memory_order_relaxed);
+                if (count.compare_exchange_strong(current, 1, memory_order_release, memory_order_relaxed)) { return index; }
+                // Another thread brought the shard up first, so its central reference is spare.
+                // The caller holds a reference of its own so this cannot be the last one.
+                control->central.fetch_sub(1, memory_order_relaxed);
+            }
+        }
+
+        inline void release_shard(sharded_control* control, size_t index) noexcept {
+            if (control->shards[index].count.fetch_sub(1, memory_order_acq_rel) != 1) { return; }
+            if (control->central.fetch_sub(1, memory_order_acq_rel) != 1) { return; }
+            control->destroy(control);
+        }
+    }
+
+    template <class T>
+    class sharded_shared_ptr {
+    public:
+        typedef T element_type;
+        typedef ptrdiff_t difference_type;
+
+        template <class U>
+        using rebind = sharded_shared_ptr<U>;
+
+    public:
+        constexpr sharded_shared_ptr() noexcept = default;
+        constexpr sharded_shared_ptr(nullptr_t) noexcept { }
+        template <class U, class = typename enable_if<is_convertible<U*, T*>::value>::type>
+        explicit sharded_shared_ptr(U* p);
+        sharded_shared_ptr(sharded_shared_ptr const& other) noexcept;
+        sharded_shared_ptr(sharded_shared_ptr&& other) noexcept;
+        template <class U, class = typename enable_if<is_convertible<U*, T*>::value>::type>
+        sharded_shared_ptr(sharded_shared_ptr<U> const& other) noexcept;
+        template <class U, class = typename enable_if<is_convertible<U*, T*>::value>::type>
+        sharded_shared_ptr(sharded_shared_ptr<U>&& other) noexcept;
+        ~sharded_shared_ptr();
+
+        sharded_shared_ptr& operator =(sharded_shared_ptr const& other) noexcept;
+        sharded_shared_ptr& operator =(sharded_shared_ptr&& other) noexcept;
+        sharded_shared_ptr& operator =(nullptr_t) noexcept;
+
+        T* get() const noexcept { return _ptr; }
+        T& operator *() const noexcept { return *_ptr; }
+        T* operator ->() const noexcept { return _ptr; }
+        explicit operator bool() const noexcept { return _ptr != nullptr; }
+
+        // The sum of the shards, which like shared_ptr::use_count is only a snapshot when other
+        // threads hold copies.
+        long use_count() const noexcept;
+
+        void reset() noexcept { sharded_shared_ptr().swap(*this); }
+        template <class U>
+        void reset(U* p) { sharded_shared_ptr(p).swap(*this); }
+        void swap(sharded_shared_ptr& other) noexcept;
+
+    private:
+        template <class U>
+        friend class sharded_shared_ptr;
+
+        T* _ptr = nullptr;
+        __detail::sharded_control* _control = nullptr;
+        size_t _shard = 0;
+    };
+
+    template <class T, class... Args>
+    sharded_shared_ptr<T> make_sharded_shared(Args&&... args) {
+        return sharded_shared_ptr<T>(new T(std::forward<Args>(args)...));
+    }
+
+    template <class T>
+    template <class U, class>
+    sharded_shared_ptr<T>::sharded_shared_ptr(U* p) : _ptr(p) {
+        __detail::sharded_control_for<U>* control = nullptr;
+        try {
+            control = new __detail::sharded_control_for<U>();
+            control->mask = __detail::reference_shard_count() - 1;
+            control->shards = new __detail::reference_shard[control->mask + 1];
+        } catch (...) {
+            delete control;
+            delete p;
+            throw;
+        }
+        control->object = p;
+        control->destroy = [](__detail::sharded_control* c) {
+            __detail::sharded_control_for<U>* self = static_cast<__detail::sharded_control_for<U>*>(c);
+            delete self->object;
+            delete[] self->shards;
+            delete self;
+        };
+        _control = control;
+        _shard = __detail::acquire_shard(_control);
+    }
+
+    template <class T>
+    sharded_shared_ptr<T>::sharded_shared_ptr(sharded_shared_ptr const& other) noexcept
+      : _ptr(other._ptr), _control(other._control) {
+        if (_control) { _shard = __detail::acquire_shard(_control); }
+    }
+
+    template <class T>
+    sharded_shared_ptr<T>::sharded_shared_ptr(sharded_shared_ptr&& other) noexcept
+      : _ptr(other._ptr), _control(other._control), _shard(other._shard) {
+        other._ptr = nullptr;
+        other._control = nullptr;
+    }
+
+    template <class T>
+    template <class U, class>
+    sharded_shared_ptr<T>::sharded_shared_ptr(sharded_shared_ptr<U> const& other) noexcept
+      : _ptr(other._ptr), _control(other._control) {
+        if (_control) { _shard = __detail::acquire_shard(_control); }
+    }
+
+    template <class T>
+    template <class U, class>
+    sharded_shared_ptr<T>::sharded_shared_ptr(sharded_shared_ptr<U>&& other) noexcept
+      : _ptr(other._ptr), _control(other._control), _shard(other._shard) {
+        other._ptr = nullptr;
+        other._control = nullptr;
+    }
+
+    template <class T>
+    sharded_shared_ptr<T>::~sharded_shared_ptr() {
+        if (_control) { __detail::release_shard(_control, _shard); }
+    }
+
+    template <class T>
+    sharded_shared_ptr<T>& sharded_shared_ptr<T>::operator =(sharded_shared_ptr const& other) noexcept {
+        sharded_shared_ptr(other).swap(*this);
+        return *this;
+    }
+
+    template <class T>
+    sharded_shared_ptr<T>& sharded_shared_ptr<T>::operator =(sharded_shared_ptr&& other) noexcept {
+        sharded_shared_ptr(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    template <class T>
+    sharded_shared_ptr<T>& sharded_shared_ptr<T>::operator =(nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    template <class T>
+    long sharded_shared_ptr<T>::use_count() const noexcept {
+        if (!_control) { return 0; }
+        long count = 0;
+        for (size_t i = 0; i <= _control->mask; ++i) {
+            count += _control->shards[i].count.load(memory_order_relaxed);
+        }
+        return count;
+    }
+
+    template <class T>
+    void sharded_shared_ptr<T>::swap(sharded_shared_ptr& other) noexcept {
+        std::swap(_ptr, other._ptr);
+        std::swap(_control, other._control);
+        std::swap(_shard, other._shard);
+    }
+
+    template <class T1, class T2>
+    bool operator ==(sharded_shared_ptr<T1> const& a, sharded_shared_ptr<T2> const& b) noexcept { return a.get() == b.get(); }
+
+    template <class T1, class T2>
+    bool operator !=(sharded_shared_ptr<T1> const& a, sharded_shared_ptr<T2> const& b) noexcept { return a.get() != b.get(); }
+
+    template <class T>
+    bool operator ==(sharded_shared_ptr<T> const& a, nullptr_t) noexcept { return !a; }
+
+    template <class T>
+    bool operator !=(sharded_shared_ptr<T> const& a, nullptr_t) noexcept { return static_cast<bool>(a); }
+
+    template <class T1, class T2>
+    bool operator <(sharded_shared_ptr<T1> const& a, sharded_shared_ptr<T2> const& b) noexcept { return less<>()(a.get(), b.get()); }
+}
+
+    template <class T>
+    struct hash<experimental::sharded_shared_ptr<T>> {
+        size_t operator ()(experimental::sharded_shared_ptr<T> const& p) const noexcept { return hash<T*>()(p.get()); }
+    };
+}
+
+#endif // __SHARDED_SHARED_PTR_H__
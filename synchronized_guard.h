@@ -0,0 +1,315 @@
+/**
+ * A guard of a pointer whose pointee is protected by a lock. Like a ptr_guard the pointee is only
+ * reached through call(), which tests the pointer and holds the lock for the duration of the call,
+ * so the null check and the locking cannot be forgotten or done in the wrong order. A read path
+ * takes a shared lock where the lock supports one, and call_synchronized locks several guards at
+ * once without risk of deadlock.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __SYNCHRONIZED_GUARD_H__
+#define __SYNCHRONIZED_GUARD_H__
+
+#include "ptr_guard.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+namespace std {
+namespace experimental {
+    // A sequence lock. Writers lock it exclusively, while readers take no lock at all but copy
+    // the value and retry when a write overlapped the copy. Reads never block writers, so it
+    // suits small, frequently read values which are written rarely.
+    class seq_lock {
+    public:
+        seq_lock() noexcept = default;
+        seq_lock(seq_lock const&) = delete;
+        seq_lock& operator =(seq_lock const&) = delete;
+
+        void lock() noexcept;
+        bool try_lock() noexcept;
+        void unlock() noexcept;
+
+        // A read is valid when read_retry with the sequence from read_begin returns false.
+        unsigned read_begin() const noexcept;
+        bool read_retry(unsigned sequence) const noexcept;
+
+    private:
+        atomic<unsigned> _sequence{ 0 };
+    };
+
+    template <class P, class Lock>
+    class synchronized_guard;
+
+    namespace __detail {
+        template <class L, class = void>
+        struct read_lock_for {
+            typedef unique_lock<L> type;
+        };
+
+        template <class L>
+        struct read_lock_for<L, void_t<decltype(declval<L&>().lock_shared())>> {
+            typedef shared_lock<L> type;
+        };
+
+        struct synchronized_access {
+            template <class P, class Lock>
+            static ptr_guard<P>& guard(synchronized_guard<P, Lock>& g) noexcept { return g._guard; }
+
+            template <class P, class Lock>
+            static Lock& lock(synchronized_guard<P, Lock>& g) noexcept { return g._lock; }
+        };
+
+        struct lock_entry {
+            void* lock;
+            void (*acquire)(void*);
+            void (*release)(void*) noexcept;
+        };
+
+        template <class L>
+        lock_entry make_lock_entry(L& lock) noexcept {
+            return lock_entry{ std::addressof(lock),
+                               [](void* l) { static_cast<L*>(l)->lock(); },
+                               [](void* l) noexcept { static_cast<L*>(l)->unlock(); } };
+        }
+
+        // Holds a set of locks, acquired in address order so any two threads locking overlapping
+        // sets take their common locks in the same order. A lock appearing twice is taken once.
+        template <size_t N>
+        class ordered_locks {
+        public:
+            explicit ordered_locks(array<lock_entry, N> locks);
+            ~ordered_locks();
+
+            ordered_locks(ordered_locks const&) = delete;
+            ordered_locks& operator =(ordered_locks const&) = delete;
+
+        private:
+            void release_all() noexcept;
+
+            array<lock_entry, N> _locks;
+            size_t _count = 0;
+        };
+
+        template <size_t N>
+        ordered_locks<N>::ordered_locks(array<lock_entry, N> locks) : _locks(locks) {
+            sort(_locks.begin(), _locks.end(), [](lock_entry const& a, lock_entry const& b) {
+                return less<void*>()(a.lock, b.lock);
+            });
+            try {
+                for (size_t i = 0; i < N; ++i) {
+                    if (i && _locks[i].lock == _locks[_count - 1].lock) { continue; }
+                    _locks[i].acquire(_locks[i].lock);
+                    _locks[_count++] = _locks[i];
+                }
+            } catch (...) {
+                // The destructor does not run when construction throws, so the locks already
+                // taken are released here.
+                release_all();
+                throw;
+            }
+        }
+
+        template <size_t N>
+        ordered_locks<N>::~ordered_locks() {
+            release_all();
+        }
+
+        template <size_t N>
+        void ordered_locks<N>::release_all() noexcept {
+            while (_count) {
+                --_count;
+                _locks[_count].release(_locks[_count].lock);
+            }
+        }
+    }
+
+    // Lock is any lockable type. call() and call_or() hold it exclusively and give mutable access
+    // to the pointee. call_shared() and call_shared_or() give const access, under a shared lock
+    // when Lock has lock_shared. With a seq_lock they instead pass a copy of the pointee taken
+    // without locking, which needs a trivially copyable pointer and pointee, and a pointee which
+    // outlives the guard's use of it, as the pointee of a guarded raw pointer must.
+    template <class P, class Lock = mutex>
+    class synchronized_guard {
+    public:
+        typedef ptr_guard<P> guard_type;
+        typedef typename guard_type::pointer pointer;
+        typedef typename guard_type::element_type element_type;
+        typedef Lock lock_type;
+
+        synchronized_guard() = default;
+        synchronized_guard(nullptr_t) noexcept { }
+        explicit synchronized_guard(P p) noexcept : _guard(std::move(p)) { }
+        explicit synchronized_guard(guard_type guard) noexcept : _guard(std::move(guard)) { }
+
+        synchronized_guard(synchronized_guard const&) = delete;
+        synchronized_guard& operator =(synchronized_guard const&) = delete;
+
+        operator bool() const;
+
+        // Replaces the pointer while holding the lock exclusively.
+        template <class... Args>
+        void reset(Args&&... args);
+
+        template <class Func, class... Args>
+        void call(Func&& func, Args&&... args);
+
+        template <class Func, class Ret, class... Args>
+        Ret call_or(Func&& func, Ret&& def, Args&&... args);
+
+        template <class Func, class... Args>
+        void call_shared(Func&& func, Args&&... args) const;
+
+        template <class Func, class Ret, class... Args>
+        Ret call_shared_or(Func&& func, Ret&& def, Args&&... args) const;
+
+    private:
+        friend struct __detail::synchronized_access;
+
+        typedef ptr_guard<element_type const*> view_type;
+
+        static constexpr bool is_seq_locked = is_same<Lock, seq_lock>::value;
+
+        bool read_copy(element_type& copy) const;
+
+        guard_type _guard;
+        mutable Lock _lock;
+    };
+
+    // Locks every guard in address order, then calls func with the pointees if all are non null.
+    template <class Func, class... Ps, class... Locks>
+    void call_synchronized(Func&& func, synchronized_guard<Ps, Locks>&... guards);
+
+    inline void seq_lock::lock() noexcept {
+        unsigned sequence = _sequence.load(memory_order_relaxed);
+        while ((sequence & 1) || !_sequence.compare_exchange_weak(sequence, sequence + 1, memory_order_acquire, memory_order_relaxed)) {
+            if (sequence & 1) {
+                this_thread::yield();
+                sequence = _sequence.load(memory_order_relaxed);
+            }
+        }
+        // The writes under the lock must not be seen before the odd sequence.
+        atomic_thread_fence(memory_order_release);
+    }
+
+    inline bool seq_lock::try_lock() noexcept {
+        unsigned sequence = _sequence.load(memory_order_relaxed);
+        if ((sequence & 1) || !_sequence.compare_exchange_strong(sequence, sequence + 1, memory_order_acquire, memory_order_relaxed)) {
+            return false;
+        }
+        atomic_thread_fence(memory_order_release);
+        return true;
+    }
+
+    inline void seq_lock::unlock() noexcept {
+        _sequence.fetch_add(1, memory_order_release);
+    }
+
+    inline unsigned seq_lock::read_begin() const noexcept {
+        unsigned sequence;
+        while ((sequence = _sequence.load(memory_order_acquire)) & 1) { this_thread::yield(); }
+        return sequence;
+    }
+
+    inline bool seq_lock::read_retry(unsigned sequence) const noexcept {
+        atomic_thread_fence(memory_order_acquire);
+        return _sequence.load(memory_order_relaxed) != sequence;
+    }
+
+    template <class P, class Lock>
+    synchronized_guard<P, Lock>::operator bool() const {
+        if constexpr (is_seq_locked) {
+            static_assert(is_trivially_copyable<pointer>::value, "A seq_lock synchronized_guard needs a trivially copyable pointer.");
+            for (;;) {
+                unsigned sequence = _lock.read_begin();
+                pointer p;
+                memcpy(static_cast<void*>(&p), &__detail::access_guarded_pointer(_guard), sizeof(p));
+                if (!_lock.read_retry(sequence)) { return __detail::test_ptr(p); }
+            }
+        } else {
+            typename __detail::read_lock_for<Lock>::type lock(_lock);
+            return static_cast<bool>(_guard);
+        }
+    }
+
+    template <class P, class Lock>
+    template <class... Args>
+    void synchronized_guard<P, Lock>::reset(Args&&... args) {
+        lock_guard<Lock> lock(_lock);
+        _guard.reset(std::forward<Args>(args)...);
+    }
+
+    template <class P, class Lock>
+    template <class Func, class... Args>
+    void synchronized_guard<P, Lock>::call(Func&& func, Args&&... args) {
+        lock_guard<Lock> lock(_lock);
+        _guard.call(std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+
+    template <class P, class Lock>
+    template <class Func, class Ret, class... Args>
+    Ret synchronized_guard<P, Lock>::call_or(Func&& func, Ret&& def, Args&&... args) {
+        lock_guard<Lock> lock(_lock);
+        return _guard.call_or(std::forward<Func>(func), std::forward<Ret>(def), std::forward<Args>(args)...);
+    }
+
+    template <class P, class Lock>
+    template <class Func, class... Args>
+    void synchronized_guard<P, Lock>::call_shared(Func&& func, Args&&... args) const {
+        if constexpr (is_seq_locked) {
+            element_type copy;
+            if (read_copy(copy)) { view_type(std::addressof(copy)).call(std::forward<Func>(func), std::forward<Args>(args)...); }
+        } else {
+            typename __detail::read_lock_for<Lock>::type lock(_lock);
+            view_type(_guard).call(std::forward<Func>(func), std::forward<Args>(args)...);
+        }
+    }
+
+    template <class P, class Lock>
+    template <class Func, class Ret, class... Args>
+    Ret synchronized_guard<P, Lock>::call_shared_or(Func&& func, Ret&& def, Args&&... args) const {
+        if constexpr (is_seq_locked) {
+            element_type copy;
+            if (!read_copy(copy)) { return def; }
+            return view_type(std::addressof(copy)).call_or(std::forward<Func>(func), std::forward<Ret>(def), std::forward<Args>(args)...);
+        } else {
+            typename __detail::read_lock_for<Lock>::type lock(_lock);
+            return view_type(_guard).call_or(std::forward<Func>(func), std::forward<Ret>(def), std::forward<Args>(args)...);
+        }
+    }
+
+    template <class P, class Lock>
+    bool synchronized_guard<P, Lock>::read_copy(element_type& copy) const {
+        static_assert(is_trivially_copyable<pointer>::value, "A seq_lock synchronized_guard needs a trivially copyable pointer.");
+        static_assert(is_trivially_copyable<element_type>::value, "A seq_lock synchronized_guard needs a trivially copyable pointee.");
+
+        // The pointer and the pointee are copied byte wise, since either may be torn by a
+        // concurrent write, and are only used once the sequence shows no write overlapped.
+        for (;;) {
+            unsigned sequence = _lock.read_begin();
+            pointer p;
+            memcpy(static_cast<void*>(&p), &__detail::access_guarded_pointer(_guard), sizeof(p));
+            bool valid = __detail::test_ptr(p);
+            if (valid) { memcpy(static_cast<void*>(std::addressof(copy)), std::addressof(*p), sizeof(copy)); }
+            if (!_lock.read_retry(sequence)) { return valid; }
+        }
+    }
+
+    template <class Func, class... Ps, class... Locks>
+    void call_synchronized(Func&& func, synchronized_guard<Ps, Locks>&... guards) {
+        static_assert(sizeof...(Ps) > 0, "call_synchronized takes one or more synchronized guards.");
+        __detail::ordered_locks<sizeof...(Ps)> locks(array<__detail::lock_entry, sizeof...(Ps)>{{
+            __detail::make_lock_entry(__detail::synchronized_access::lock(guards))... }});
+        __detail::check_all_then_invoke(func, __detail::synchronized_access::guard(guards)...);
+    }
+}
+}
+
+#endif // __SYNCHRONIZED_GUARD_H__
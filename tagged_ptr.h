@@ -0,0 +1,106 @@
+/**
+ * A pointer carrying a small tag in the low bits its pointee's alignment leaves clear, so a node
+ * needing a pointer and a few flags needs no separate flag member. The null test and dereference
+ * ignore the tag. The pointer satisfies pointer_traits so ptr_guard<tagged_ptr<T, Bits>> guards
+ * it like any other pointer, and get_tag and set_tag access the tag of a guarded tagged_ptr
+ * without exposing the pointer.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __TAGGED_PTR_H__
+#define __TAGGED_PTR_H__
+
+#include "ptr_guard.h"
+
+#include <cstdint>
+
+namespace std {
+namespace experimental {
+    // Tagged pointers compare and hash on the pointer alone. The alignment of T is checked when
+    // a pointer is stored, so a tagged_ptr<T> may be declared while T is still incomplete.
+    template <class T, size_t Bits>
+    class tagged_ptr {
+        static_assert(Bits > 0 && Bits < 8, "A tagged_ptr has between 1 and 7 tag bits.");
+
+    public:
+        typedef T element_type;
+        typedef ptrdiff_t difference_type;
+
+        template <class U>
+        using rebind = tagged_ptr<U, Bits>;
+
+        static constexpr uintptr_t tag_mask = (uintptr_t(1) << Bits) - 1;
+
+    public:
+        constexpr tagged_ptr() noexcept = default;
+        constexpr tagged_ptr(nullptr_t) noexcept { }
+        tagged_ptr(T* p, uintptr_t tag = 0) noexcept { set(p, tag); }
+        template <class U, class = typename enable_if<is_convertible<U*, T*>::value>::type>
+        tagged_ptr(tagged_ptr<U, Bits> const& other) noexcept { set(other.get(), other.tag()); }
+
+        T* get() const noexcept { return reinterpret_cast<T*>(_bits & ~tag_mask); }
+        T& operator *() const noexcept { return *get(); }
+        T* operator ->() const noexcept { return get(); }
+        explicit operator bool() const noexcept { return (_bits & ~tag_mask) != 0; }
+
+        uintptr_t tag() const noexcept { return _bits & tag_mask; }
+        void set_tag(uintptr_t tag) noexcept;
+
+        // Replaces the pointer, keeping the tag.
+        void reset(T* p = nullptr) noexcept { set(p, tag()); }
+        void swap(tagged_ptr& other) noexcept { std::swap(_bits, other._bits); }
+
+        static tagged_ptr pointer_to(T& r) noexcept { return tagged_ptr(std::addressof(r)); }
+
+    private:
+        void set(T* p, uintptr_t tag) noexcept;
+
+        uintptr_t _bits = 0;
+    };
+
+    template <class T, size_t Bits>
+    void tagged_ptr<T, Bits>::set_tag(uintptr_t tag) noexcept {
+        _bits = (_bits & ~tag_mask) | (tag & tag_mask);
+    }
+
+    template <class T, size_t Bits>
+    void tagged_ptr<T, Bits>::set(T* p, uintptr_t tag) noexcept {
+        static_assert(alignof(T) > tag_mask, "The alignment of T leaves too few low bits clear for the tag.");
+        _bits = reinterpret_cast<uintptr_t>(p) | (tag & tag_mask);
+    }
+
+    template <class T, size_t Bits>
+    uintptr_t get_tag(ptr_guard<tagged_ptr<T, Bits>> const& guard) noexcept {
+        return __detail::access_guarded_pointer(guard).tag();
+    }
+
+    template <class T, size_t Bits>
+    void set_tag(ptr_guard<tagged_ptr<T, Bits>>& guard, uintptr_t tag) noexcept {
+        __detail::access_guarded_pointer(guard).set_tag(tag);
+    }
+
+    template <class T1, class T2, size_t Bits>
+    bool operator ==(tagged_ptr<T1, Bits> const& a, tagged_ptr<T2, Bits> const& b) noexcept { return a.get() == b.get(); }
+
+    template <class T1, class T2, size_t Bits>
+    bool operator !=(tagged_ptr<T1, Bits> const& a, tagged_ptr<T2, Bits> const& b) noexcept { return a.get() != b.get(); }
+
+    template <class T, size_t Bits>
+    bool operator ==(tagged_ptr<T, Bits> const& a, nullptr_t) noexcept { return !a; }
+
+    template <class T, size_t Bits>
+    bool operator !=(tagged_ptr<T, Bits> const& a, nullptr_t) noexcept { return static_cast<bool>(a); }
+
+    template <class T1, class T2, size_t Bits>
+    bool operator <(tagged_ptr<T1, Bits> const& a, tagged_ptr<T2, Bits> const& b) noexcept { return less<>()(a.get(), b.get()); }
+}
+
+    template <class T, size_t Bits>
+    struct hash<experimental::tagged_ptr<T, Bits>> {
+        size_t operator ()(experimental::tagged_ptr<T, Bits> const& p) const noexcept { return hash<T*>()(p.get()); }
+    };
+}
+
+#endif // __TAGGED_PTR_H__
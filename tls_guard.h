@@ -0,0 +1,290 @@
+/**
+ * A guard of a per thread instance. Each thread calling through a tls_guard is given an instance
+ * of its own, made by the guard's factory on the thread's first call and destroyed when the
+ * thread exits, so scratch objects such as buffers and random number generators are never shared
+ * between threads on a hot path. The instances are reached only through call() and call_or(), and
+ * for_each() visits the instances of every thread for aggregating per thread state.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __TLS_GUARD_H__
+#define __TLS_GUARD_H__
+
+#include "ptr_guard.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace std {
+namespace experimental {
+    namespace __detail {
+        struct tls_control;
+
+        // The instance of one tls_guard on one thread. It is owned by the thread, and linked into
+        // the guard's list of instances while the guard is alive.
+        struct tls_entry {
+            shared_ptr<tls_control> control;
+            void* object;
+            void (*destroy)(void*) noexcept;
+            tls_entry* prev = nullptr;
+            tls_entry* next = nullptr;
+        };
+
+        // The state of a tls_guard which its threads' entries share. It outlives the guard until
+        // the last thread holding an entry for it exits, so its id is not reused before then.
+        struct tls_control {
+            explicit tls_control(size_t id) noexcept : id(id) { }
+            ~tls_control();
+
+            void link(tls_entry* entry) noexcept;
+            void unlink(tls_entry* entry) noexcept;
+
+            const size_t id;
+            mutex lock;
+            tls_entry* entries = nullptr;
+            bool alive = true;
+        };
+
+        class tls_ids {
+        public:
+            static tls_ids& instance();
+
+            size_t acquire();
+            void release(size_t id) noexcept;
+
+        private:
+            mutex _lock;
+            vector<size_t> _free;
+            size_t _next = 0;
+        };
+
+        // The entries of one thread, indexed by the ids of their guards.
+        struct tls_thread {
+            tls_thread() noexcept;
+            ~tls_thread();
+
+            static tls_thread& current();
+            static tls_thread*& current_if_alive() noexcept;
+
+            vector<tls_entry*> slots;
+        };
+
+        void release_tls_entry(tls_entry* entry) noexcept;
+
+        template <class T>
+        struct default_tls_factory {
+            unique_ptr<T> operator ()() const { return unique_ptr<T>(new T()); }
+        };
+
+        template <class T>
+        void destroy_tls_object(void* object) noexcept {
+            delete static_cast<T*>(object);
+        }
+    }
+
+    // Factory is called with no arguments and returns a unique_ptr<T>. It is called at most once
+    // per thread, unless it returns null, when the call is skipped and the factory is called again
+    // by the thread's next call. Calls on different threads may run concurrently, but for_each
+    // also visits the instances of other threads, so state it reads must be safe to share.
+    template <class T, class Factory = __detail::default_tls_factory<T>>
+    class tls_guard {
+    public:
+        typedef T element_type;
+        typedef Factory factory_type;
+
+        tls_guard();
+        explicit tls_guard(Factory factory);
+        ~tls_guard();
+
+        tls_guard(tls_guard const&) = delete;
+        tls_guard& operator =(tls_guard const&) = delete;
+
+        // Calls func with the calling thread's instance, and a dereference of each guard in args.
+        template <class Func, class... Args>
+        void call(Func&& func, Args&&... args) const;
+
+        template <class Func, class Ret, class... Args>
+        Ret call_or(Func&& func, Ret&& def, Args&&... args) const;
+
+        // Calls func with the instance of each thread which has one, returning the number of
+        // instances. The instances of threads which have exited are already destroyed. New
+        // instances wait for the enumeration, so func must not use this guard.
+        template <class Func>
+        size_t for_each(Func&& func) const;
+
+        // Destroys the calling thread's instance, if it has one.
+        void reset() noexcept;
+
+    private:
+        T* local() const;
+
+        shared_ptr<__detail::tls_control> _control;
+        Factory _factory;
+    };
+
+    inline __detail::tls_control::~tls_control() {
+        tls_ids::instance().release(id);
+    }
+
+    inline void __detail::tls_control::link(tls_entry* entry) noexcept {
+        entry->prev = nullptr;
+        entry->next = entries;
+        if (entries) { entries->prev = entry; }
+        entries = entry;
+    }
+
+    inline void __detail::tls_control::unlink(tls_entry* entry) noexcept {
+        if (entry->prev) { entry->prev->next = entry->next; } else { entries = entry->next; }
+        if (entry->next) { entry->next->prev = entry->prev; }
+        entry->prev = entry->next = nullptr;
+    }
+
+    inline __detail::tls_ids& __detail::tls_ids::instance() {
+        // Never destroyed, as threads may release ids while static objects are destroyed.
+        static tls_ids* ids = new tls_ids();
+        return *ids;
+    }
+
+    inline size_t __detail::tls_ids::acquire() {
+        lock_guard<mutex> lock(_lock);
+        if (_free.empty()) {
+            // Reserving room to free every id handed out keeps release from allocating.
+            _free.reserve(_next + 1);
+            return _next++;
+        }
+        size_t id = _free.back();
+        _free.pop_back();
+        return id;
+    }
+
+    inline void __detail::tls_ids::release(size_t id) noexcept {
+        lock_guard<mutex> lock(_lock);
+        _free.push_back(id);
+    }
+
+    inline __detail::tls_thread::tls_thread() noexcept {
+        current_if_alive() = this;
+    }
+
+    inline __detail::tls_thread::~tls_thread() {
+        // Destroying an instance may create instances of other guards, so repeat until none are left.
+        while (!slots.empty()) {
+            vector<tls_entry*> released;
+            released.swap(slots);
+            for (tls_entry* entry : released) {
+                if (entry) { release_tls_entry(entry); }
+            }
+        }
+        current_if_alive() = nullptr;
+    }
+
+    inline __detail::tls_thread& __detail::tls_thread::current() {
+        thread_local tls_thread thread;
+        return thread;
+    }
+
+    inline __detail::tls_thread*& __detail::tls_thread::current_if_alive() noexcept {
+        // Trivially destructible, so it may still be read after the thread's tls_thread is gone.
+        thread_local tls_thread* thread = nullptr;
+        return thread;
+    }
+
+    inline void __detail::release_tls_entry(tls_entry* entry) noexcept {
+        void* object;
+        {
+            lock_guard<mutex> lock(entry->control->lock);
+            if (entry->control->alive) { entry->control->unlink(entry); }
+            object = entry->object;
+            entry->object = nullptr;
+        }
+        if (object) { entry->destroy(object); }
+        delete entry;
+    }
+
+    template <class T, class Factory>
+    tls_guard<T, Factory>::tls_guard() : tls_guard(Factory()) { }
+
+    template <class T, class Factory>
+    tls_guard<T, Factory>::tls_guard(Factory factory)
+      : _control(make_shared<__detail::tls_control>(__detail::tls_ids::instance().acquire())),
+        _factory(std::move(factory)) { }
+
+    template <class T, class Factory>
+    tls_guard<T, Factory>::~tls_guard() {
+        reset();
+
+        // The instances of other threads are destroyed here, and their entries left for those
+        // threads to free when they exit.
+        vector<void*> objects;
+        {
+            lock_guard<mutex> lock(_control->lock);
+            for (__detail::tls_entry* entry = _control->entries; entry; entry = entry->next) {
+                if (entry->object) { objects.push_back(entry->object); }
+                entry->object = nullptr;
+            }
+            _control->entries = nullptr;
+            _control->alive = false;
+        }
+        for (void* object : objects) { __detail::destroy_tls_object<T>(object); }
+    }
+
+    template <class T, class Factory>
+    template <class Func, class... Args>
+    void tls_guard<T, Factory>::call(Func&& func, Args&&... args) const {
+        ptr_guard<T*>(local()).call(std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+
+    template <class T, class Factory>
+    template <class Func, class Ret, class... Args>
+    Ret tls_guard<T, Factory>::call_or(Func&& func, Ret&& def, Args&&... args) const {
+        return ptr_guard<T*>(local()).call_or(std::forward<Func>(func), std::forward<Ret>(def), std::forward<Args>(args)...);
+    }
+
+    template <class T, class Factory>
+    template <class Func>
+    size_t tls_guard<T, Factory>::for_each(Func&& func) const {
+        size_t count = 0;
+        lock_guard<mutex> lock(_control->lock);
+        for (__detail::tls_entry* entry = _control->entries; entry; entry = entry->next) {
+            if (!entry->object) { continue; }
+            std::invoke(func, *static_cast<T*>(entry->object));
+            ++count;
+        }
+        return count;
+    }
+
+    template <class T, class Factory>
+    void tls_guard<T, Factory>::reset() noexcept {
+        __detail::tls_thread* thread = __detail::tls_thread::current_if_alive();
+        const size_t id = _control->id;
+        if (!thread || id >= thread->slots.size() || !thread->slots[id]) { return; }
+        __detail::tls_entry* entry = thread->slots[id];
+        thread->slots[id] = nullptr;
+        __detail::release_tls_entry(entry);
+    }
+
+    template <class T, class Factory>
+    T* tls_guard<T, Factory>::local() const {
+        __detail::tls_thread& thread = __detail::tls_thread::current();
+        const size_t id = _control->id;
+        if (id < thread.slots.size() && thread.slots[id]) { return static_cast<T*>(thread.slots[id]->object); }
+
+        unique_ptr<T> created(_factory());
+        if (!created) { return nullptr; }
+        if (id >= thread.slots.size()) { thread.slots.resize(id + 1, nullptr); }
+
+        unique_ptr<__detail::tls_entry> entry(new __detail::tls_entry{ _control, created.get(), &__detail::destroy_tls_object<T> });
+        {
+            lock_guard<mutex> lock(_control->lock);
+            _control->link(entry.get());
+        }
+        thread.slots[id] = entry.release();
+        return created.release();
+    }
+}
+}
+
+#endif // __TLS_GUARD_H__
@@ -0,0 +1,193 @@
+/**
+ * A non owning pointer which is nulled when its target is destroyed. Targets derive from
+ * trackable, which keeps an intrusive list of the tracked_ptrs pointing at them, so unlike
+ * ptr_guard<weak_ptr<T>> the target needs no shared_ptr control block and testing the guard is a
+ * plain load of the pointer.
+ *
+ * Original work Copyright (c) 2018 Nicolas Croad
+ * Modified work Copyright (c) [COPYRIGHT HOLDER]
+ */
+
+#ifndef __TRACKED_PTR_H__
+#define __TRACKED_PTR_H__
+
+#include "ptr_guard.h"
+
+namespace std {
+namespace experimental {
+    namespace __detail {
+        // The slot is the pointer which points at this node, either the list head in the
+        // trackable or the next pointer of the previous node, so a node unlinks itself without
+        // knowing its target.
+        struct tracking_node {
+            tracking_node** slot;
+            tracking_node* next;
+            void* object;
+        };
+    }
+
+    // Tracking is not synchronized. The target and every tracked_ptr pointing at it must only be
+    // used from one thread at a time. Copying or assigning a trackable does not copy its
+    // trackers, which stay with the original object.
+    //
+    // The trackable destructor runs after the destructors of derived classes, so until then its
+    // trackers still test non null and can reach a partly destroyed object. A derived class whose
+    // destructor may cause calls through its trackers should call untrack_all() first.
+    class trackable {
+    public:
+        trackable() noexcept { }
+        trackable(trackable const&) noexcept { }
+        trackable& operator =(trackable const&) noexcept { return *this; }
+        ~trackable();
+
+        size_t tracker_count() const noexcept;
+
+        // Nulls every tracked_ptr pointing at this object.
+        void untrack_all() noexcept;
+
+    private:
+        template <class T>
+        friend class tracked_ptr;
+
+        mutable __detail::tracking_node* _trackers = nullptr;
+    };
+
+    template <class T>
+    class tracked_ptr {
+    public:
+        typedef T element_type;
+        typedef ptrdiff_t difference_type;
+
+        template <class U>
+        using rebind = tracked_ptr<U>;
+
+    public:
+        constexpr tracked_ptr() noexcept = default;
+        constexpr tracked_ptr(nullptr_t) noexcept { }
+        tracked_ptr(T* p) noexcept { link(p); }
+        tracked_ptr(tracked_ptr const& other) noexcept { link(other.get()); }
+        tracked_ptr(tracked_ptr&& other) noexcept;
+        template <class U, class = typename enable_if<is_convertible<U*, T*>::value>::type>
+        tracked_ptr(tracked_ptr<U> const& other) noexcept { link(other.get()); }
+        ~tracked_ptr() { unlink(); }
+
+        tracked_ptr& operator =(tracked_ptr const& other) noexcept;
+        tracked_ptr& operator =(T* p) noexcept;
+        tracked_ptr& operator =(nullptr_t) noexcept;
+
+        T* get() const noexcept { return static_cast<T*>(_node.object); }
+        T& operator *() const noexcept { return *get(); }
+        T* operator ->() const noexcept { return get(); }
+        explicit operator bool() const noexcept { return _node.object != nullptr; }
+
+        void reset(T* p = nullptr) noexcept;
+        void swap(tracked_ptr& other) noexcept;
+
+        static tracked_ptr pointer_to(T& r) noexcept { return tracked_ptr(std::addressof(r)); }
+
+    private:
+        void link(T* p) noexcept;
+        void unlink() noexcept;
+
+        __detail::tracking_node _node = { nullptr, nullptr, nullptr };
+    };
+
+    inline trackable::~trackable() {
+        untrack_all();
+    }
+
+    inline void trackable::untrack_all() noexcept {
+        for (__detail::tracking_node* node = _trackers; node; ) {
+            __detail::tracking_node* next = node->next;
+            *node = __detail::tracking_node{ nullptr, nullptr, nullptr };
+            node = next;
+        }
+        _trackers = nullptr;
+    }
+
+    inline size_t trackable::tracker_count() const noexcept {
+        size_t count = 0;
+        for (__detail::tracking_node* node = _trackers; node; node = node->next) { ++count; }
+        return count;
+    }
+
+    template <class T>
+    tracked_ptr<T>::tracked_ptr(tracked_ptr&& other) noexcept {
+        link(other.get());
+        other.unlink();
+    }
+
+    template <class T>
+    tracked_ptr<T>& tracked_ptr<T>::operator =(tracked_ptr const& other) noexcept {
+        reset(other.get());
+        return *this;
+    }
+
+    template <class T>
+    tracked_ptr<T>& tracked_ptr<T>::operator =(T* p) noexcept {
+        reset(p);
+        return *this;
+    }
+
+    template <class T>
+    tracked_ptr<T>& tracked_ptr<T>::operator =(nullptr_t) noexcept {
+        unlink();
+        return *this;
+    }
+
+    template <class T>
+    void tracked_ptr<T>::reset(T* p) noexcept {
+        if (p == get()) { return; }
+        unlink();
+        link(p);
+    }
+
+    template <class T>
+    void tracked_ptr<T>::swap(tracked_ptr& other) noexcept {
+        T* p = get();
+        reset(other.get());
+        other.reset(p);
+    }
+
+    template <class T>
+    void tracked_ptr<T>::link(T* p) noexcept {
+        if (!p) { return; }
+        const trackable& target = *p;
+        _node.object = const_cast<void*>(static_cast<const volatile void*>(p));
+        _node.next = target._trackers;
+        if (_node.next) { _node.next->slot = &_node.next; }
+        _node.slot = &target._trackers;
+        target._trackers = &_node;
+    }
+
+    template <class T>
+    void tracked_ptr<T>::unlink() noexcept {
+        if (!_node.object) { return; }
+        *_node.slot = _node.next;
+        if (_node.next) { _node.next->slot = _node.slot; }
+        _node = __detail::tracking_node{ nullptr, nullptr, nullptr };
+    }
+
+    template <class T1, class T2>
+    bool operator ==(tracked_ptr<T1> const& a, tracked_ptr<T2> const& b) noexcept { return a.get() == b.get(); }
+
+    template <class T1, class T2>
+    bool operator !=(tracked_ptr<T1> const& a, tracked_ptr<T2> const& b) noexcept { return a.get() != b.get(); }
+
+    template <class T>
+    bool operator ==(tracked_ptr<T> const& a, nullptr_t) noexcept { return !a; }
+
+    template <class T>
+    bool operator !=(tracked_ptr<T> const& a, nullptr_t) noexcept { return static_cast<bool>(a); }
+
+    template <class T1, class T2>
+    bool operator <(tracked_ptr<T1> const& a, tracked_ptr<T2> const& b) noexcept { return less<>()(a.get(), b.get()); }
+}
+
+    template <class T>
+    struct hash<experimental::tracked_ptr<T>> {
+        size_t operator ()(experimental::tracked_ptr<T> const& p) const noexcept { return hash<T*>()(p.get()); }
+    };
+}
+
+#endif // __TRACKED_PTR_H__